@@ -8,31 +8,26 @@
 #include <app/ui/KernelArgWidget.hpp>
 #include <app/ui/ComputableImageWidget.hpp>
 
-#include "clc/CLC_Sources.hpp"
 #include "ComputableImage.hpp"
+#include "DefaultKernels.hpp"
+#include "DeviceProbe.hpp"
+#include "Metrics.hpp"
+#include "NativeNewtonFractal.hpp"
+#include "OpenCLImageEngine.hpp"
+#ifdef FRACTALEXPLORER_WITH_SYCL
+#include "SyclNewtonFractal.hpp"
+#endif
+#include "Tracer.hpp"
 #include "Utility.hpp"
 
 LOGGER()
 
-static OpenCLBackendPtr backend =
-    std::make_shared<OpenCLBackend>();
+static OpenCLBackendPtr backend;
 static auto confStorage = std::make_shared<KernelArgConfigurationStorage<UIProperties>>();
 
-auto id = KernelId { "newton_fractal", "default" };
-
-void registerDefaultAlgorithms(OpenCLBackendPtr backend) {
-    cl::Program::Sources newton;
-    newton.reserve(4);
-    // TODO abstract?
-    auto stdlib = sourcesRegistry.findById(STDLIB);
-    newton.insert(std::end(newton), stdlib.begin(), stdlib.end());
-    auto newtonSpecific = sourcesRegistry.findById("newton-fractal");
-    newton.insert(std::end(newton), newtonSpecific.begin(), newtonSpecific.end());
-
-    backend->registerKernel(
-        id, KernelBase { newton, { "-DUSE_DOUBLE_PRECISION" } }
-    );
+auto id = NEWTON_FRACTAL_ID;
 
+void registerDefaultAlgorithms() {
     std::string_view str = R"(
         0    0 -1 1                 0
         1    0 -1 1                 0
@@ -48,24 +43,144 @@ void registerDefaultAlgorithms(OpenCLBackendPtr backend) {
         seed    1 0 1               1
         12      0 0 0 0 0 0 0 0 0   1
         13                          1
+        14                          1
+        15                          1
     )";
 
-    confStorage->registerConfiguration(id, str.data());
+    confStorage->registerConfiguration(NEWTON_FRACTAL_ID, str.data());
+    // the same with density buffer
+    confStorage->registerConfiguration(NEWTON_FRACTAL_ACCUMULATE_ID, std::string { str } + "16 1\n");
+}
+
+ImageEnginePtr makeOpenCLEngine() {
+    logger->info(fmt::format("CL: {}", cl::Platform::getDefault().getInfo<CL_PLATFORM_NAME>()));
+
+    // pick the fastest device for interactive rendering. startup uses cached probe results; if there are none
+    // (first run, devices or drivers changed) or --reprobe is given, probe runs here, before anything else is
+    // submitted to devices, so that its timings are not skewed by compiles or renders
+    auto probeFile = cacheDirectory() / "device-probe.txt";
+    auto probeResults = QCoreApplication::arguments().contains("--reprobe")
+        ? std::nullopt
+        : cachedDeviceProbe(probeFile);
+    if (!probeResults) {
+        logger->info("Probing devices");
+        probeResults = probeDevices(defaultKernels().front().second, probeFile, true);
+    }
+    const auto& interactiveDevice = fastestDevice(*probeResults);
+    logger->info(fmt::format("Using device {} for interactive rendering", interactiveDevice.name));
+    backend = std::make_shared<OpenCLBackend>(interactiveDevice.device);
+    // device is not partitioned (see OpenCLBackend::partitionQueues): application submits no batch jobs, so
+    // interactive frames get every compute unit
+
+    // binaries precompiled during the build (see clc-precompile) are shipped next to the executable
+    backend->binaryCache().addReadOnlyDirectory(
+        std::filesystem::path(QCoreApplication::applicationDirPath().toStdString()) / "kernels");
+
+    registerDefaultKernels(*backend);
+
+    if (QCoreApplication::arguments().contains("--co-execution")) {
+        backend->enableCoExecution();
+    }
+
+    // compile everything in background while window is being set up
+    backend->precompileRegisteredKernels();
+
+    return std::make_shared<OpenCLImageEngine>(backend, id, Range<2> { 512, 512 });
+}
+
+/**
+ * Engines which can be used on this host.
+ */
+std::vector<ImageEnginePtr> availableEngines(bool withOpenCL) {
+    std::vector<ImageEnginePtr> engines;
+    if (withOpenCL) {
+        engines.push_back(makeOpenCLEngine());
+    }
+    engines.push_back(std::make_shared<NativeNewtonFractalEngine>(512, 512));
+#ifdef FRACTALEXPLORER_WITH_SYCL
+    engines.push_back(std::make_shared<SyclNewtonFractalEngine>(512, 512));
+#endif
+    return engines;
+}
+
+/**
+ * Engine selected with --engine opencl|native|sycl|fastest. OpenCL is used by default, native engine when there
+ * is no OpenCL. "fastest" measures every available engine on the probe workload and picks the fastest one.
+ */
+ImageEnginePtr makeEngine() {
+    auto args = QCoreApplication::arguments();
+    auto engineArg = args.indexOf("--engine");
+    auto requested = engineArg >= 0 && engineArg + 1 < args.size() ? args[engineArg + 1].toStdString() : "opencl";
+
+    bool withOpenCL = requested != "native" && requested != "sycl" && openCLAvailable();
+    if (requested == "opencl" && !withOpenCL) {
+        logger->warn("OpenCL is not available, falling back to native engine");
+        requested = "native";
+    }
+
+    if (requested == "fastest") {
+        return fastestEngine(availableEngines(withOpenCL), newtonFractalProbeArgs(1024), 512 * 512);
+    }
+    if (requested == "native") {
+        return std::make_shared<NativeNewtonFractalEngine>(512, 512);
+    }
+#ifdef FRACTALEXPLORER_WITH_SYCL
+    if (requested == "sycl") {
+        return std::make_shared<SyclNewtonFractalEngine>(512, 512);
+    }
+#endif
+    if (requested != "opencl") {
+        logger->warn(fmt::format(
+            "Unknown or disabled engine \"{}\", using {}", requested, withOpenCL ? "opencl" : "native"));
+        if (!withOpenCL) {
+            return std::make_shared<NativeNewtonFractalEngine>(512, 512);
+        }
+    }
+    return makeOpenCLEngine();
 }
 
 int main(int argc, char *argv[]) {
     QApplication a(argc, argv);
-    logger->info(fmt::format("CL: {}", cl::Platform::getDefault().getInfo<CL_PLATFORM_NAME>()));
 
-    registerDefaultAlgorithms(backend);
+    registerDefaultAlgorithms();
+
+    // --accumulate: image refines progressively while parameters stay the same
+    if (QCoreApplication::arguments().contains("--accumulate")) {
+        id = NEWTON_FRACTAL_ACCUMULATE_ID;
+    }
+
+    auto engine = makeEngine();
+    logger->info(fmt::format("Using {} engine", engine->name()));
+    if (!(id == NEWTON_FRACTAL_ID) && !dynamic_cast<OpenCLImageEngine*>(engine.get())) {
+        logger->warn(fmt::format("{} engine does not accumulate, rendering flat images", engine->name()));
+        id = NEWTON_FRACTAL_ID;
+    }
+
+    // FRACTALEXPLORER_TRACE=<file> records a trace of the whole session
+    const char* traceFile = std::getenv("FRACTALEXPLORER_TRACE");
+    if (traceFile && *traceFile) {
+        Tracer::instance().start();
+    }
+
+    Metrics::instance().startReporting(std::chrono::seconds(10));
 
     QMainWindow w;
 
-    ParameterizedComputableImageWidget img(backend, confStorage, {512, 512}, id);
+    ParameterizedComputableImageWidget img(engine, confStorage, {512, 512}, id);
 
     w.setCentralWidget(&img);
 
     w.show();
 
-    return QApplication::exec();
+    auto status = QApplication::exec();
+
+    if (traceFile && *traceFile && Tracer::enabled()) {
+        Tracer::instance().stop(traceFile);
+    }
+
+    Metrics::instance().stopReporting();
+    // flush asynchronous loggers
+    spdlog::shutdown();
+
+    return status;
 }
\ No newline at end of file
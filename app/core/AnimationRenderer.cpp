@@ -0,0 +1,244 @@
+#include "AnimationRenderer.hpp"
+
+#include "ImageIO.hpp"
+#include "Tracer.hpp"
+#include "Utility.hpp"
+
+#include <absl/strings/match.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+LOGGER()
+
+/**
+ * Host buffers of frames in flight: two being computed / read back, the rest queued for or being encoded.
+ * Once all are taken, rendering waits for the writer.
+ */
+static constexpr size_t frameBuffers = 4;
+
+/**
+ * Encodes frames on its own thread and recycles their buffers.
+ */
+class FrameWriter {
+
+    FrameSink& sink_;
+    size_t width_, height_;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<std::pair<size_t, std::vector<uint32_t>>> queue_;
+    std::vector<std::vector<uint32_t>> free_;
+    bool finished_ = false;
+    std::exception_ptr error_;
+
+    std::thread thread_;
+
+    void run() {
+        while (true) {
+            std::pair<size_t, std::vector<uint32_t>> frame;
+            {
+                std::unique_lock lock { mutex_ };
+                changed_.wait(lock, [this]() { return !queue_.empty() || finished_; });
+                if (queue_.empty()) {
+                    return;
+                }
+                frame = std::move(queue_.front());
+                queue_.pop_front();
+            }
+
+            try {
+                TRACE_SCOPE("FrameWriter::write")
+                sink_.write(frame.first, frame.second.data(), width_, height_);
+            } catch (...) {
+                std::lock_guard lock { mutex_ };
+                error_ = std::current_exception();
+                queue_.clear();
+                finished_ = true;
+                changed_.notify_all();
+                return;
+            }
+
+            std::lock_guard lock { mutex_ };
+            free_.push_back(std::move(frame.second));
+            changed_.notify_all();
+        }
+    }
+
+public:
+
+    FrameWriter(FrameSink& sink, size_t width, size_t height)
+        : sink_(sink), width_(width), height_(height)
+    {
+        for (size_t i = 0; i < frameBuffers; ++i) {
+            free_.emplace_back(width * height);
+        }
+        thread_ = std::thread { &FrameWriter::run, this };
+    }
+
+    ~FrameWriter() {
+        stop();
+    }
+
+    /**
+     * Buffer for the next frame. Waits until writer returns one; rethrows error of the writer.
+     */
+    std::vector<uint32_t> acquire() {
+        std::unique_lock lock { mutex_ };
+        changed_.wait(lock, [this]() { return !free_.empty() || error_; });
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+        auto buffer = std::move(free_.back());
+        free_.pop_back();
+        return buffer;
+    }
+
+    void push(size_t frame, std::vector<uint32_t>&& pixels) {
+        {
+            std::lock_guard lock { mutex_ };
+            queue_.emplace_back(frame, std::move(pixels));
+        }
+        changed_.notify_all();
+    }
+
+    /**
+     * Wait until all pushed frames are written; rethrows error of the writer.
+     */
+    void finish() {
+        stop();
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+private:
+
+    void stop() {
+        if (!thread_.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard lock { mutex_ };
+            finished_ = true;
+        }
+        changed_.notify_all();
+        thread_.join();
+    }
+};
+
+ImageSequenceSink::ImageSequenceSink(std::string pattern) : pattern_(std::move(pattern)) {}
+
+void ImageSequenceSink::write(size_t frame, const uint32_t* pixels, size_t width, size_t height) {
+    auto begin = pattern_.find('#');
+    auto end = pattern_.find_first_not_of('#', begin);
+    auto digits = (end == std::string::npos ? pattern_.size() : end) - begin;
+    auto number = std::to_string(frame);
+    if (number.size() < digits) {
+        number.insert(0, digits - number.size(), '0');
+    }
+    auto path = pattern_;
+    path.replace(begin, digits, number);
+    writeImage(path, pixels, width, height);
+}
+
+Y4MSink::Y4MSink(const std::filesystem::path& path, size_t fps) : out_(path, std::ios::binary), fps_(fps) {
+    if (!out_) {
+        auto err = fmt::format("Cannot open {} for writing", path.string());
+        logger->error(err);
+        throw std::runtime_error(err);
+    }
+}
+
+void Y4MSink::write(size_t frame, const uint32_t* pixels, size_t width, size_t height) {
+    if (!headerWritten_) {
+        writeY4MHeader(out_, width, height, fps_);
+        headerWritten_ = true;
+    }
+    writeY4MFrame(out_, pixels, width, height);
+    if (!out_) {
+        auto err = fmt::format("Failed to write frame {}", frame);
+        logger->error(err);
+        throw std::runtime_error(err);
+    }
+}
+
+std::unique_ptr<FrameSink> makeFrameSink(const std::string& output, size_t fps) {
+    if (absl::EndsWithIgnoreCase(output, ".y4m")) {
+        return std::make_unique<Y4MSink>(output, fps);
+    }
+    if (output.find('#') == std::string::npos) {
+        auto err = fmt::format("Image sequence output '{}' must contain frame number placeholder, e.g. #####",
+            output);
+        logger->error(err);
+        throw std::invalid_argument(err);
+    }
+    return std::make_unique<ImageSequenceSink>(output);
+}
+
+void renderAnimation(OpenCLBackendPtr backend, const KernelId& id, Range<2> size, const KernelArgs& base,
+                     const Evolution& evolution, size_t numFrames, FrameSink& sink) {
+    TRACE_SCOPE("renderAnimation")
+    FrameWriter writer { sink, size[0], size[1] };
+
+    // frame N+2 reuses image of frame N: queue is in-order, so it is only overwritten after being read back
+    std::array<std::unique_ptr<OpenCLComputableImage<Dim_2D>>, 2> images {
+        std::make_unique<OpenCLComputableImage<Dim_2D>>(backend, size),
+        std::make_unique<OpenCLComputableImage<Dim_2D>>(backend, size)
+    };
+
+    struct InFlight {
+        size_t frame;
+        std::vector<uint32_t> pixels;
+        cl::Event read;
+    };
+    std::optional<InFlight> previous;
+
+    auto queue = backend->currentQueue(JobPriority::Batch);
+    try {
+        for (size_t frame = 0; frame < numFrames; ++frame) {
+            auto& image = *images[frame % images.size()];
+            auto args = evolution.argsAt(frame, base);
+            image.clear(backend, { 1.0f, 1.0f, 1.0f, 1.0f }, JobPriority::Batch, id);
+            image.compute<NoUserProperties>(backend, id, args, JobPriority::Batch);
+
+            InFlight current { frame, writer.acquire(), {} };
+            current.read = image.read(backend, current.pixels.data(), JobPriority::Batch, id);
+            // submit now, so that device works on this frame while host waits for the previous one
+            queue.flush();
+
+            if (previous) {
+                previous->read.wait();
+                writer.push(previous->frame, std::move(previous->pixels));
+            }
+            previous = std::move(current);
+            LOG_DEBUG("Frame {}/{} enqueued", frame + 1, numFrames);
+        }
+        if (previous) {
+            previous->read.wait();
+            writer.push(previous->frame, std::move(previous->pixels));
+        }
+    } catch (...) {
+        // reads in flight still target host buffers which are about to be freed
+        queue.finish();
+        throw;
+    }
+
+    writer.finish();
+}
+
+void renderAnimation(ImageEngine& engine, Range<2> size, const KernelArgs& base,
+                     const Evolution& evolution, size_t numFrames, FrameSink& sink) {
+    TRACE_SCOPE("renderAnimation")
+    FrameWriter writer { sink, size[0], size[1] };
+    engine.resize(size[0], size[1]);
+    for (size_t frame = 0; frame < numFrames; ++frame) {
+        engine.compute(evolution.argsAt(frame, base));
+        auto pixels = writer.acquire();
+        engine.read(pixels.data());
+        writer.push(frame, std::move(pixels));
+    }
+    writer.finish();
+}
@@ -0,0 +1,76 @@
+#ifndef FRACTALEXPLORER_ANIMATIONRENDERER_HPP
+#define FRACTALEXPLORER_ANIMATIONRENDERER_HPP
+
+#include "ComputableImage.hpp"
+#include "Evolution.hpp"
+#include "ImageEngine.hpp"
+
+#include <fstream>
+#include <memory>
+
+/**
+ * Destination of rendered frames. Frames are written from a single thread, in order.
+ */
+class FrameSink {
+public:
+
+    virtual ~FrameSink() = default;
+
+    virtual void write(size_t frame, const uint32_t* pixels, size_t width, size_t height) = 0;
+
+};
+
+/**
+ * Frame per image file. The first run of '#' in path pattern is replaced by zero-padded frame number,
+ * e.g. "frames/#####.png".
+ */
+class ImageSequenceSink : public FrameSink {
+
+    std::string pattern_;
+
+public:
+
+    explicit ImageSequenceSink(std::string pattern);
+
+    void write(size_t frame, const uint32_t* pixels, size_t width, size_t height) override;
+
+};
+
+/**
+ * Raw YUV4MPEG2 stream, which ffmpeg and most players read directly.
+ */
+class Y4MSink : public FrameSink {
+
+    std::ofstream out_;
+    size_t fps_;
+    bool headerWritten_ = false;
+
+public:
+
+    Y4MSink(const std::filesystem::path& path, size_t fps);
+
+    void write(size_t frame, const uint32_t* pixels, size_t width, size_t height) override;
+
+};
+
+/**
+ * Y4M stream for outputs ending with .y4m, image sequence otherwise.
+ */
+std::unique_ptr<FrameSink> makeFrameSink(const std::string& output, size_t fps);
+
+/**
+ * Render frames [0; numFrames) of evolution with OpenCL on the batch queue. Frames are pipelined: frame N+1 is
+ * enqueued before waiting for readback of frame N, and frame N-1 is encoded by writer thread meanwhile, so that
+ * device does not idle between frames. Number of frames in flight is bounded.
+ */
+void renderAnimation(OpenCLBackendPtr backend, const KernelId& id, Range<2> size, const KernelArgs& base,
+                     const Evolution& evolution, size_t numFrames, FrameSink& sink);
+
+/**
+ * Render frames [0; numFrames) of evolution with engine which has no asynchronous readback. Computation only
+ * overlaps with encoding.
+ */
+void renderAnimation(ImageEngine& engine, Range<2> size, const KernelArgs& base,
+                     const Evolution& evolution, size_t numFrames, FrameSink& sink);
+
+#endif //FRACTALEXPLORER_ANIMATIONRENDERER_HPP
@@ -0,0 +1,335 @@
+#include "CoExecution.hpp"
+
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cmath>
+
+LOGGER()
+
+/**
+ * Devices are never starved completely, so that their throughput keeps being measured.
+ */
+static constexpr double minimalShare = 0.02;
+
+/**
+ * Weight of the latest measurement in throughput and frame time estimation.
+ */
+static constexpr double throughputSmoothing = 0.5;
+
+static double smooth(double estimate, double measured) {
+    return estimate == 0 ? measured : throughputSmoothing * measured + (1 - throughputSmoothing) * estimate;
+}
+
+/**
+ * Pack color the way it is stored in CL_RGBA / CL_UNORM_INT8 image.
+ */
+static uint32_t packColor(cl_float4 color) {
+    auto channel = [](float v) {
+        return static_cast<uint32_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 255.0f));
+    };
+    return channel(color.s[0]) | channel(color.s[1]) << 8 | channel(color.s[2]) << 16 | channel(color.s[3]) << 24;
+}
+
+RowShares::RowShares(size_t numDevices)
+    : shares_(numDevices, numDevices > 0 ? 1.0 / numDevices : 0.0),
+      throughputs_(numDevices, 0.0)
+{}
+
+std::vector<size_t> RowShares::split(size_t height) const {
+    std::vector<size_t> rows(shares_.size());
+    size_t assigned = 0, largest = 0;
+    for (size_t i = 0; i < shares_.size(); ++i) {
+        rows[i] = static_cast<size_t>(std::floor(shares_[i] * height));
+        assigned += rows[i];
+        if (shares_[i] > shares_[largest]) {
+            largest = i;
+        }
+    }
+    if (!rows.empty()) {
+        rows[largest] += height - assigned;
+    }
+    return rows;
+}
+
+void RowShares::rebalance(const std::vector<size_t>& rows, const std::vector<double>& seconds) {
+    double total = 0;
+    for (size_t i = 0; i < shares_.size(); ++i) {
+        if (rows[i] > 0 && seconds[i] > 0) {
+            throughputs_[i] = smooth(throughputs_[i], rows[i] / seconds[i]);
+        }
+        total += throughputs_[i];
+    }
+    if (total <= 0) {
+        return;
+    }
+
+    double totalShare = 0;
+    for (size_t i = 0; i < shares_.size(); ++i) {
+        shares_[i] = std::max(throughputs_[i] / total, minimalShare);
+        totalShare += shares_[i];
+    }
+    for (auto& share : shares_) {
+        share /= totalShare;
+    }
+}
+
+CoExecutionScheduler::CoExecutionScheduler() {
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+
+    for (const auto& platform : platforms) {
+        std::vector<cl::Device> devices;
+        try {
+            platform.getDevices(CL_DEVICE_TYPE_ALL, &devices);
+        } catch (const cl::Error& e) {
+            logger->warn(fmt::format(
+                "Cannot list devices of platform {}: {} ({})", platform.getInfo<CL_PLATFORM_NAME>(), e.what(), e.err()
+            ));
+            continue;
+        }
+        if (devices.empty()) {
+            continue;
+        }
+
+        // one context per platform, so that a program is built once for all of its devices
+        cl::Context ctx { devices };
+        auto pool = std::make_shared<DeviceMemoryPool>(
+            std::make_shared<DeviceMemoryBudget>(DeviceMemoryBudget::defaultLimit(ctx))
+        );
+        for (const auto& device : devices) {
+            DeviceSlot slot;
+            slot.device = device;
+            slot.ctx = ctx;
+            slot.pool = pool;
+            slot.queue = cl::CommandQueue { ctx, device, CL_QUEUE_PROFILING_ENABLE };
+            slot.name = fmt::format("{} / {}", platform.getInfo<CL_PLATFORM_NAME>(), device.getInfo<CL_DEVICE_NAME>());
+            slots_.push_back(std::move(slot));
+        }
+    }
+
+    if (slots_.empty()) {
+        auto err = "No OpenCL devices available for co-execution";
+        logger->error(err);
+        throw std::runtime_error(err);
+    }
+
+    shares_ = RowShares { slots_.size() };
+    for (auto& slot : slots_) {
+        logger->info(fmt::format("Co-execution device: {}", slot.name));
+    }
+}
+
+void CoExecutionScheduler::resize(size_t width, size_t height) {
+    if (width == width_ && height == height_) {
+        return;
+    }
+    auto hitMaskWords = RenderStatistics::hitMaskWords(width * height);
+    for (auto& slot : slots_) {
+        // reads of a cancelled frame may still be writing into host copies
+        slot.queue.finish();
+        auto& pool = *slot.pool;
+        pool.release(slot.image);
+        slot.image = pool.acquireImage2D(slot.ctx, CL_MEM_READ_WRITE, { CL_RGBA, CL_UNORM_INT8 }, width, height);
+        slot.pixels.resize(width * height);
+
+        if (slot.stats() == nullptr) {
+            slot.stats = pool.acquireBuffer(slot.ctx, CL_MEM_READ_WRITE, sizeof(slot.counters));
+        }
+        pool.release(slot.hitMask);
+        slot.hitMask = pool.acquireBuffer(slot.ctx, CL_MEM_READ_WRITE, hitMaskWords * sizeof(cl_uint));
+        slot.hitMaskHost.resize(hitMaskWords);
+    }
+    merged_.resize(width * height);
+    mergedHitMask_.resize(hitMaskWords);
+    width_ = width;
+    height_ = height;
+}
+
+void CoExecutionScheduler::collectSingleDeviceFrame() {
+    if (pendingSingleDevice_.empty()) {
+        return;
+    }
+    double seconds = 0;
+    for (const auto& event : pendingSingleDevice_) {
+        if (event.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>() != CL_COMPLETE) {
+            return;
+        }
+        auto start = event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+        auto end = event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+        seconds += (end - start) * 1e-9;
+    }
+    pendingSingleDevice_.clear();
+    singleDeviceSeconds_ = smooth(singleDeviceSeconds_, seconds);
+}
+
+bool CoExecutionScheduler::shouldCoExecute() {
+    collectSingleDeviceFrame();
+    if (coExecutedSeconds_ == 0) {
+        return true;
+    }
+    if (singleDeviceSeconds_ == 0) {
+        return false;
+    }
+
+    bool faster = coExecutedSeconds_ < singleDeviceSeconds_;
+    if (faster != coExecuting_) {
+        logger->info(fmt::format(
+            "Co-execution {}: {:.2f} ms per frame, {:.2f} ms on backend device alone",
+            faster ? "enabled" : "disabled", coExecutedSeconds_ * 1e3, singleDeviceSeconds_ * 1e3
+        ));
+        coExecuting_ = faster;
+    }
+    // frame times depend on args, so the option not in use is measured again from time to time
+    if (++framesSinceProbe_ >= probeInterval) {
+        framesSinceProbe_ = 0;
+        return !coExecuting_;
+    }
+    return coExecuting_;
+}
+
+void CoExecutionScheduler::singleDeviceFrame(std::vector<cl::Event> kernels) {
+    pendingSingleDevice_ = std::move(kernels);
+}
+
+bool CoExecutionScheduler::render(
+    OpenCLBackend& backend, const KernelId& id, const KernelArgs& args,
+    size_t width, size_t height, cl_float4 background,
+    const cl::CommandQueue& targetQueue, const cl::Image2D& target,
+    std::optional<RenderStatistics>& statistics, const SlicedDispatch* slicing
+) {
+    statistics.reset();
+    if (slicing && slicing->cancelled()) {
+        return false;
+    }
+    auto frameStart = std::chrono::steady_clock::now();
+    resize(width, height);
+    // rows of the global range, i.e. share of samples; each device still plots into the whole image
+    auto rows = shares_.split(height);
+
+    cl::size_t<3> origin, region;
+    region[0] = width;
+    region[1] = height;
+    region[2] = 1;
+
+    std::vector<cl::Event> kernelEvents(slots_.size()), readEvents(slots_.size());
+    auto hitMaskBytes = mergedHitMask_.size() * sizeof(cl_uint);
+    bool collectStatistics = true;
+    size_t firstRow = 0;
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        if (rows[i] == 0) {
+            continue;
+        }
+        auto& slot = slots_[i];
+        auto compiled = backend.compileSpecializedKernel<NoUserProperties>(id, args, slot.ctx);
+        auto kernel = compiled.kernel();
+
+        // devices may differ in precision, so argument types are detected per device
+        if (!slot.argTypes) {
+            slot.argTypes = detectArgumentTypesAndNames(kernel);
+        }
+        auto converted = convertArgs(*slot.argTypes, args);
+        applyArgsToKernel(kernel, converted.begin(), converted.end());
+        kernel.setArg(compiled.imageArg(), slot.image);
+        for (size_t d = 0; d < compiled.dimensionalArgs().size(); ++d) {
+            kernel.setArg(compiled.dimensionalArgs()[d], d == 0 ? width : height);
+        }
+
+        auto statsArg = compiled.nameMap().find("stats");
+        auto hitMaskArg = compiled.nameMap().find("hit_mask");
+        bool slotCollects = statsArg != compiled.nameMap().end() && hitMaskArg != compiled.nameMap().end();
+        collectStatistics = collectStatistics && slotCollects;
+        if (slotCollects) {
+            slot.queue.enqueueFillBuffer(slot.stats, cl_uint { 0 }, 0, sizeof(slot.counters));
+            slot.queue.enqueueFillBuffer(slot.hitMask, cl_uint { 0 }, 0, hitMaskBytes);
+            kernel.setArg(statsArg->second, slot.stats);
+            kernel.setArg(hitMaskArg->second, slot.hitMask);
+        }
+
+        slot.queue.enqueueFillImage(slot.image, background, origin, region);
+        slot.queue.enqueueNDRangeKernel(
+            kernel, { 0, firstRow }, { width, rows[i] }, cl::NullRange, nullptr, &kernelEvents[i]
+        );
+        slot.queue.enqueueReadImage(
+            slot.image, CL_FALSE, origin, region, 0, 0, slot.pixels.data(), nullptr, &readEvents[i]
+        );
+        if (slotCollects) {
+            // queue is in-order, so waiting for the last read is enough
+            slot.queue.enqueueReadBuffer(slot.stats, CL_FALSE, 0, sizeof(slot.counters), slot.counters.data());
+            slot.queue.enqueueReadBuffer(
+                slot.hitMask, CL_FALSE, 0, hitMaskBytes, slot.hitMaskHost.data(), nullptr, &readEvents[i]
+            );
+        }
+        slot.queue.flush();
+
+        firstRow += rows[i];
+    }
+
+    const auto backgroundPixel = packColor(background);
+    std::fill(merged_.begin(), merged_.end(), backgroundPixel);
+    std::fill(mergedHitMask_.begin(), mergedHitMask_.end(), 0);
+    RenderStatistics summed;
+
+    std::vector<double> seconds(slots_.size(), 0.0);
+    size_t rowsDone = 0;
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        if (rows[i] == 0) {
+            continue;
+        }
+        // devices still running finish on their own; their copies are overwritten by the next frame
+        if (slicing && slicing->cancelled()) {
+            LOG_DEBUG("Co-executed computation cancelled with {} of {} rows finished", rowsDone, height);
+            return false;
+        }
+        readEvents[i].wait();
+        rowsDone += rows[i];
+        if (slicing && slicing->progress) {
+            slicing->progress(static_cast<double>(rowsDone) / static_cast<double>(height));
+        }
+
+        auto start = kernelEvents[i].getProfilingInfo<CL_PROFILING_COMMAND_START>();
+        auto end = kernelEvents[i].getProfilingInfo<CL_PROFILING_COMMAND_END>();
+        seconds[i] = (end - start) * 1e-9;
+
+        const auto& pixels = slots_[i].pixels;
+        for (size_t p = 0; p < merged_.size(); ++p) {
+            if (pixels[p] != backgroundPixel) {
+                merged_[p] = pixels[p];
+            }
+        }
+
+        if (collectStatistics) {
+            auto slotStatistics = RenderStatistics::fromDeviceCounters(slots_[i].counters);
+            summed.pointsGenerated += slotStatistics.pointsGenerated;
+            summed.pointsInViewport += slotStatistics.pointsInViewport;
+            summed.frozenTrajectories += slotStatistics.frozenTrajectories;
+            summed.solverFailures += slotStatistics.solverFailures;
+            // devices plot into their own copies of image, so pixels hit by several devices are counted once
+            const auto& hitMask = slots_[i].hitMaskHost;
+            for (size_t w = 0; w < mergedHitMask_.size(); ++w) {
+                mergedHitMask_[w] |= hitMask[w];
+            }
+        }
+    }
+
+    targetQueue.enqueueWriteImage(target, CL_TRUE, origin, region, 0, 0, merged_.data());
+    coExecutedSeconds_ = smooth(
+        coExecutedSeconds_, std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count()
+    );
+
+    shares_.rebalance(rows, seconds);
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        LOG_DEBUG("{}: {:.0f} rows/s, share {:.3f}", slots_[i].name, shares_.throughputs()[i], shares_.shares()[i]);
+    }
+
+    if (!collectStatistics) {
+        return true;
+    }
+    for (auto word : mergedHitMask_) {
+        summed.distinctPixels += static_cast<uint32_t>(std::bitset<32>(word).count());
+    }
+    statistics = summed;
+    return true;
+}
@@ -0,0 +1,145 @@
+#ifndef FRACTALEXPLORER_COEXECUTION_HPP
+#define FRACTALEXPLORER_COEXECUTION_HPP
+
+#include "OpenCLBackend.hpp"
+#include "RenderStatistics.hpp"
+#include "SlicedDispatch.hpp"
+
+#include <optional>
+#include <vector>
+
+/**
+ * Shares of the global range of co-executing devices, proportional to their measured throughput. Kept apart from
+ * devices, so that it can be exercised without any.
+ */
+class RowShares {
+
+    std::vector<double> shares_;
+
+    std::vector<double> throughputs_; // rows per second, zero until measured
+
+public:
+
+    /**
+     * Equal shares of given number of devices.
+     */
+    explicit RowShares(size_t numDevices);
+
+    /**
+     * Rows of every device, summing up to height; rounding remainder goes to the device with the largest share.
+     */
+    std::vector<size_t> split(size_t height) const;
+
+    /**
+     * Update throughput of devices which computed given rows in given seconds, and shares following it. No device
+     * share drops below a minimum, so that throughput of every device keeps being measured.
+     */
+    void rebalance(const std::vector<size_t>& rows, const std::vector<double>& seconds);
+
+    inline const std::vector<double>& shares() const noexcept { return shares_; }
+
+    inline const std::vector<double>& throughputs() const noexcept { return throughputs_; }
+
+};
+
+/**
+ * Splits computation of a 2D image across every OpenCL device of every platform.
+ *
+ * What is split is the sampling budget, i.e. the global range: each device runs a share of its rows (work items),
+ * but newton_fractal plots points anywhere in the image, so outputs of devices are not disjoint. Every device
+ * draws into its own copy of the whole image, every copy is read back and merged on host, and the result is
+ * written into the target image. Shares follow measured per-device throughput.
+ *
+ * These transfers can cost more than the extra devices save, so co-execution is only kept while its frames are
+ * faster than frames computed by backend device alone (see shouldCoExecute).
+ */
+class CoExecutionScheduler {
+
+    struct DeviceSlot {
+        cl::Device device;
+        cl::Context ctx;
+        cl::CommandQueue queue;
+        std::string name;
+        /**
+         * Shared by devices of a platform context, with its own budget: memory of co-execution devices is not
+         * memory of the backend device.
+         */
+        std::shared_ptr<DeviceMemoryPool> pool;
+
+        std::optional<ArgsTypesWithNames> argTypes;
+        cl::Image2D image;
+        std::vector<uint32_t> pixels;
+
+        cl::Buffer stats, hitMask;
+        RenderStatistics::DeviceCounters counters {};
+        std::vector<cl_uint> hitMaskHost;
+    };
+
+    std::vector<DeviceSlot> slots_;
+
+    RowShares shares_ { 0 };
+
+    std::vector<uint32_t> merged_;
+
+    std::vector<cl_uint> mergedHitMask_;
+
+    size_t width_ = 0, height_ = 0;
+
+    /**
+     * Smoothed duration of a frame: co-executed one from start to target write, single-device one on device.
+     */
+    double coExecutedSeconds_ = 0, singleDeviceSeconds_ = 0;
+
+    std::vector<cl::Event> pendingSingleDevice_;
+
+    bool coExecuting_ = true;
+
+    size_t framesSinceProbe_ = 0;
+
+    void collectSingleDeviceFrame();
+
+    void resize(size_t width, size_t height);
+
+public:
+
+    /**
+     * Enumerates all platforms and devices. Throws if there are none.
+     */
+    CoExecutionScheduler();
+
+    /**
+     * The option which is not used is measured again once per this many frames.
+     */
+    static constexpr size_t probeInterval = 32;
+
+    inline size_t numDevices() const noexcept { return slots_.size(); }
+
+    /**
+     * Whether next frame should be co-executed rather than computed by backend device alone, by measured frame
+     * times of both.
+     */
+    bool shouldCoExecute();
+
+    /**
+     * Report kernel commands of a frame computed by backend device alone. Their device time is read once they
+     * complete.
+     */
+    void singleDeviceFrame(std::vector<cl::Event> kernels);
+
+    /**
+     * Compute kernel over [width x height] range on all devices and write merged result into target image.
+     * Blocks until target image is written. Statistics are summed over devices, if kernel collects them.
+     *
+     * Devices are not sliced, but slicing is still checked for cancellation before launch and whenever a device
+     * finishes, and told progress in rows finished so far. Returns false if cancelled; target is not written then.
+     */
+    bool render(
+        OpenCLBackend& backend, const KernelId& id, const KernelArgs& args,
+        size_t width, size_t height, cl_float4 background,
+        const cl::CommandQueue& targetQueue, const cl::Image2D& target,
+        std::optional<RenderStatistics>& statistics, const SlicedDispatch* slicing = nullptr
+    );
+
+};
+
+#endif //FRACTALEXPLORER_COEXECUTION_HPP
@@ -2,6 +2,10 @@
 #define FRACTALEXPLORER_COMPUTABLEIMAGE_HPP
 
 #include "OpenCLBackend.hpp"
+#include "CoExecution.hpp"
+#include "RenderStatistics.hpp"
+#include "SlicedDispatch.hpp"
+#include "Tracer.hpp"
 
 using Color = cl_float4;
 
@@ -50,12 +54,25 @@ struct Dim_2D {
 
     typedef cl::Image2D ImageType;
 
-    static ImageType createImage(cl::Context ctx, RangeType dim) {
-        return ImageType { ctx, CL_MEM_READ_WRITE, { CL_RGBA, CL_UNORM_INT8 }, dim[0], dim[1] };
+    static ImageType createImage(DeviceMemoryPool& pool, const cl::Context& ctx, RangeType dim, cl_mem_flags flags) {
+        return pool.acquireImage2D(ctx, flags, { CL_RGBA, CL_UNORM_INT8 }, dim[0], dim[1]);
     }
 
-    static void enqueueKernel(cl::CommandQueue queue, cl::Kernel kernel, cl::NDRange localRange, RangeType dim) {
-        queue.enqueueNDRangeKernel(kernel, {0, 0}, {dim[0], dim[1]}, localRange);
+    static bool hasDimensions(const ImageType& image, RangeType dim) {
+        return image.getImageInfo<CL_IMAGE_WIDTH>() == dim[0] && image.getImageInfo<CL_IMAGE_HEIGHT>() == dim[1];
+    }
+
+    static void enqueueKernel(cl::CommandQueue queue, cl::Kernel kernel, cl::NDRange localRange, RangeType dim,
+                              cl::Event* event = nullptr) {
+        queue.enqueueNDRangeKernel(kernel, {0, 0}, {dim[0], dim[1]}, localRange, nullptr, event);
+    }
+
+    /**
+     * Enqueue kernel over rows [firstRow; firstRow + rows) of the image.
+     */
+    static void enqueueKernelRows(cl::CommandQueue queue, cl::Kernel kernel, cl::NDRange localRange, RangeType dim,
+                                  size_t firstRow, size_t rows, cl::Event* event = nullptr) {
+        queue.enqueueNDRangeKernel(kernel, {0, firstRow}, {dim[0], rows}, localRange, nullptr, event);
     }
 };
 
@@ -70,16 +87,80 @@ public:
     using RangeType = typename DimensionPolicy::RangeType;
     using ImageType = typename DimensionPolicy::ImageType;
 
-    OpenCLComputableImage(OpenCLBackendPtr backend, RangeType dimensions) : dimensions_(dimensions) {
+    /**
+     * Host mapped image is allocated in host-accessible memory (CL_MEM_ALLOC_HOST_PTR), so that map() does not copy
+     * it on devices which share memory with host.
+     */
+    OpenCLComputableImage(OpenCLBackendPtr backend, RangeType dimensions, bool hostMapped = false)
+        : dimensions_(dimensions), pool_(backend->memoryPool()),
+          flags_(hostMapped ? CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR : CL_MEM_READ_WRITE)
+    {
         recreateImageIfNeeded(backend, dimensions);
     }
 
+    OpenCLComputableImage(const OpenCLComputableImage&) = delete;
+    OpenCLComputableImage& operator=(const OpenCLComputableImage&) = delete;
+
+    /**
+     * Device memory is returned to the pool of the backend.
+     */
+    ~OpenCLComputableImage() {
+        pool_->release(image_);
+        pool_->release(statsBuffer_);
+        pool_->release(hitMask_);
+        pool_->release(density_);
+    }
+
+    /**
+     * Change dimensions of this image. Device memory of the old size is kept in the pool for later reuse.
+     */
+    void resize(OpenCLBackendPtr backend, RangeType dimensions) {
+        dimensions_ = dimensions;
+        recreateImageIfNeeded(backend, dimensions_);
+    }
+
+    inline RangeType dimensions() const noexcept { return dimensions_; }
+
+    inline bool hostMapped() const noexcept { return (flags_ & CL_MEM_ALLOC_HOST_PTR) != 0; }
+
+    /**
+     * Compute this image using given kernel. Jobs of different priorities are submitted to different queues.
+     *
+     * With slicing, 2D image is computed in bands of rows (see SlicedDispatch), and this call returns once all of
+     * them are finished. Returns false if computation was cancelled; image is incomplete then and has no
+     * statistics. Co-executed images are not split into slices, but are still cancelled and report progress per
+     * device. With co-execution enabled, image is only co-executed while that is measured to be faster than
+     * computing it on backend device alone.
+     */
     template <typename KernelInstanceProperties>
-    void compute(OpenCLBackendPtr backend, KernelId id, const KernelArgs& args) {
-        auto queue = backend->currentQueue();
-        auto compiled = backend->compileKernel<KernelInstanceProperties>(id);
-//        auto localRange = backend->findKernelBase(id).localRange;
-        auto localRange = cl::NDRange {};
+    bool compute(OpenCLBackendPtr backend, KernelId id, const KernelArgs& args,
+                 JobPriority priority = JobPriority::Interactive, const SlicedDispatch* slicing = nullptr) {
+        auto queue = backend->currentQueue(priority);
+        statistics_.reset();
+        statsRead_ = cl::Event {};
+
+        // density stays on the device it was accumulated on, so accumulating kernels are not split
+        CoExecutionScheduler* coExecution = nullptr;
+        if constexpr (DimensionPolicy::N == 2) {
+            if (backend->coExecution() && !accumulates<KernelInstanceProperties>(backend, id)) {
+                coExecution = backend->coExecution();
+            }
+            if (coExecution && coExecution->shouldCoExecute()) {
+                recreateImageIfNeeded(backend, dimensions_);
+                return coExecution->render(
+                    *backend, id, args, dimensions_[0], dimensions_[1], clearColor_, queue, image_, statistics_,
+                    slicing
+                );
+            }
+        }
+
+        LaunchConfiguration launch;
+        if constexpr (DimensionPolicy::N == 2) {
+            launch = backend->launchConfiguration(id, args, dimensions_[0], dimensions_[1]);
+        }
+        // generic kernel serves frames until the variant specialized for these args and options is compiled
+        auto compiled = backend->compileSpecializedKernel<KernelInstanceProperties>(id, args, launch.options);
+        auto localRange = DimensionPolicy::N == 2 ? launch.localRange(dimensions_[0], dimensions_[1]) : cl::NullRange;
 
         recreateImageIfNeeded(backend, dimensions_);
 
@@ -88,10 +169,8 @@ public:
         compiled.kernel().setArg(compiled.imageArg(), image_);
 
         if (DimensionPolicy::N >= compiled.dimensionalArgs().size()) {
-            logger->warn(
-                fmt::format("# of dimensional args found ({}) < # of dimensions ({}), might be error",
-                    compiled.dimensionalArgs().size(), DimensionPolicy::N
-                )
+            LOG_DEBUG("# of dimensional args found ({}) < # of dimensions ({}), might be error",
+                compiled.dimensionalArgs().size(), DimensionPolicy::N
             );
         }
 
@@ -99,16 +178,145 @@ public:
             compiled.kernel().setArg(compiled.dimensionalArgs()[i], dimensions_[i]);
         }
 
-        DimensionPolicy::enqueueKernel(backend->currentQueue(), compiled.kernel(), localRange, dimensions_);
+        bool collectStatistics = bindStatisticsBuffers(backend, queue, compiled.kernel(), compiled.nameMap());
+        if (accumulates(compiled.nameMap())) {
+            bindDensityBuffer(backend, queue, compiled.kernel(), compiled.nameMap().at("density"));
+        }
+
+        std::vector<cl::Event> kernelEvents;
+        bool sliced = false;
+        if constexpr (DimensionPolicy::N == 2) {
+            if (slicing) {
+                if (!dispatchSliced(backend, queue, id, compiled.kernel(), launch, *slicing, kernelEvents)) {
+                    return false;
+                }
+                sliced = true;
+            }
+        }
+        if (!sliced) {
+            cl::Event event;
+            DimensionPolicy::enqueueKernel(queue, compiled.kernel(), localRange, dimensions_, &event);
+            backend->profiler().record(id, ProfiledOperation::Kernel, event);
+            kernelEvents.push_back(event);
+        }
+        if (coExecution) {
+            // co-execution is only kept while it beats this
+            coExecution->singleDeviceFrame(std::move(kernelEvents));
+        }
+
+        if (collectStatistics) {
+            queue.enqueueReadBuffer(
+                statsBuffer_, CL_FALSE, 0, sizeof(statsHost_), statsHost_.data(), nullptr, &statsRead_
+            );
+            backend->profiler().record(id, ProfiledOperation::Read, statsRead_, sizeof(statsHost_));
+        }
+        return true;
     }
 
     /**
-     * Clears this image with specified color.
+     * Statistics of the last computation, if kernel collects them (has `stats` and `hit_mask` arguments).
+     * Waits until they are read back, which only takes a few bytes.
      */
-    void clear(OpenCLBackendPtr backend, Color color={1.0f, 1.0f, 1.0f, 1.0f}) {
+    std::optional<RenderStatistics> statistics() {
+        if (statsRead_() != nullptr) {
+            statsRead_.wait();
+            statistics_ = RenderStatistics::fromDeviceCounters(statsHost_);
+            statsRead_ = cl::Event {};
+        }
+        return statistics_;
+    }
+
+    /**
+     * Clears this image with specified color, and density accumulated in it (see toneMap). If id is given, fill is
+     * profiled as part of that kernel's work.
+     */
+    void clear(OpenCLBackendPtr backend, Color color={1.0f, 1.0f, 1.0f, 1.0f},
+               JobPriority priority = JobPriority::Interactive, std::optional<KernelId> id = std::nullopt) {
+        clearColor_ = color;
         recreateImageIfNeeded(backend, dimensions_);
         cl::size_t<3> origin, region = dimensions_.makeRegion();
-        backend->currentQueue().enqueueFillImage(image_, color, origin, region);
+        cl::Event event;
+        backend->currentQueue(priority).enqueueFillImage(image_, color, origin, region, nullptr, &event);
+        if (id) {
+            backend->profiler().record(*id, ProfiledOperation::Fill, event);
+        }
+        if (density_() != NULL) {
+            backend->currentQueue(priority).enqueueFillBuffer(density_, cl_uint { 0 }, 0, densityBytes());
+        }
+    }
+
+    /**
+     * Draw density accumulated by kernels with `density` argument into this image with given tone mapping kernel
+     * (see tone_map). Image is left as is if nothing was accumulated yet.
+     */
+    void toneMap(OpenCLBackendPtr backend, const KernelId& toneMapId, float gamma,
+                 JobPriority priority = JobPriority::Interactive) {
+        if (density_() == NULL) {
+            return;
+        }
+        auto toneMap = backend->compileKernel<NoUserProperties>(toneMapId);
+        const auto& names = toneMap.nameMap();
+        toneMap.kernel().setArg(names.at("density"), density_);
+        toneMap.kernel().setArg(names.at("gamma"), gamma);
+        toneMap.kernel().setArg(toneMap.imageArg(), image_);
+        cl::Event event;
+        DimensionPolicy::enqueueKernel(backend->currentQueue(priority), toneMap.kernel(), cl::NullRange, dimensions_,
+                                       &event);
+        backend->profiler().record(toneMapId, ProfiledOperation::Kernel, event);
+    }
+
+    /**
+     * Read this image into pixels, which must hold RGBA8 value for every pixel. Read is non-blocking unless blocking
+     * is set; returned event completes once pixels are written. If id is given, read is profiled as part of that
+     * kernel's work.
+     */
+    cl::Event read(OpenCLBackendPtr backend, void* pixels, JobPriority priority = JobPriority::Interactive,
+                   std::optional<KernelId> id = std::nullopt, bool blocking = false) {
+        cl::size_t<3> origin, region = dimensions_.makeRegion();
+        cl::Event event;
+        backend->currentQueue(priority).enqueueReadImage(
+            image_, blocking ? CL_TRUE : CL_FALSE, origin, region, 0, 0, pixels, nullptr, &event
+        );
+        if (id) {
+            backend->profiler().record(
+                *id, ProfiledOperation::Read, event, region[0] * region[1] * region[2] * sizeof(cl_uint)
+            );
+        }
+        return event;
+    }
+
+    struct Mapping {
+        void* pixels;
+        /**
+         * Distance between rows in bytes; may be larger than width of the image.
+         */
+        size_t rowPitch;
+        /**
+         * Completes once pixels are accessible.
+         */
+        cl::Event event;
+    };
+
+    /**
+     * Map this image for reading. Mapping is non-blocking; pixels may only be accessed once its event completes and
+     * until unmap(). Image must not be computed or cleared while mapped. If id is given, map is profiled as part of
+     * that kernel's work.
+     */
+    Mapping map(OpenCLBackendPtr backend, JobPriority priority = JobPriority::Interactive,
+                std::optional<KernelId> id = std::nullopt) {
+        cl::size_t<3> origin, region = dimensions_.makeRegion();
+        Mapping mapping {};
+        mapping.pixels = backend->currentQueue(priority).enqueueMapImage(
+            image_, CL_FALSE, CL_MAP_READ, origin, region, &mapping.rowPitch, nullptr, nullptr, &mapping.event
+        );
+        if (id) {
+            backend->profiler().record(*id, ProfiledOperation::Map, mapping.event);
+        }
+        return mapping;
+    }
+
+    void unmap(OpenCLBackendPtr backend, void* pixels, JobPriority priority = JobPriority::Interactive) {
+        backend->currentQueue(priority).enqueueUnmapMemObject(image_, pixels);
     }
 
 protected:
@@ -118,14 +326,149 @@ protected:
 private:
 
     void recreateImageIfNeeded(OpenCLBackendPtr backend, RangeType dimensions) {
-        if (image_() == NULL || memoryBelongsToContext(image_, backend->currentContext())) {
-            image_ = DimensionPolicy::createImage(backend->currentContext(), dimensions);
+        if (image_() == NULL
+            || !memoryBelongsToContext(image_, backend->currentContext())
+            || !DimensionPolicy::hasDimensions(image_, dimensions)) {
+            pool_->release(image_);
+            image_ = DimensionPolicy::createImage(*pool_, backend->currentContext(), dimensions, flags_);
+        }
+    }
+
+    /**
+     * Enqueue kernel in bands of rows. The next slice is sized and enqueued while the previous one runs, so that
+     * device does not idle between them; at most two slices are outstanding. Returns false if cancelled.
+     */
+    bool dispatchSliced(OpenCLBackendPtr backend, const cl::CommandQueue& queue, const KernelId& id,
+                        cl::Kernel kernel, const LaunchConfiguration& launch, const SlicedDispatch& slicing,
+                        std::vector<cl::Event>& events) {
+        TRACE_SCOPE("OpenCLComputableImage::dispatchSliced")
+        auto width = dimensions_[0], height = dimensions_[1];
+        // keep slices divisible by tuned local size, so that it is used for all but the last one
+        auto granularity = launch.localRange(width, height).dimensions() == 0 ? 1 : launch.localHeight;
+
+        cl::Event inFlight;
+        size_t inFlightRows = 0, rowsDone = 0;
+        // slices overlap in wall time, so they are measured by device time
+        auto finishInFlight = [&]() {
+            inFlight.wait();
+            auto start = inFlight.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+            auto end = inFlight.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+            sliceSizer_.measured(inFlightRows, std::chrono::nanoseconds(end - start));
+            rowsDone += inFlightRows;
+            if (slicing.progress) {
+                slicing.progress(static_cast<double>(rowsDone) / static_cast<double>(height));
+            }
+        };
+
+        for (size_t row = 0; row < height;) {
+            if (slicing.cancelled()) {
+                // slice in flight finishes on its own; queue is in-order, so nothing enqueued later overtakes it
+                LOG_DEBUG("Computation cancelled at row {} of {}", rowsDone, height);
+                return false;
+            }
+            auto rows = sliceSizer_.nextSlice(slicing.sliceLatency, height - row, height, granularity);
+            cl::Event event;
+            DimensionPolicy::enqueueKernelRows(
+                queue, kernel, launch.localRange(width, rows), dimensions_, row, rows, &event
+            );
+            backend->profiler().record(id, ProfiledOperation::Kernel, event);
+            events.push_back(event);
+            queue.flush();
+            if (inFlight() != nullptr) {
+                finishInFlight();
+            }
+            inFlight = event;
+            inFlightRows = rows;
+            row += rows;
         }
+        finishInFlight();
+        return true;
+    }
+
+    static bool accumulates(const ArgNameMap& names) {
+        return names.find("density") != names.end();
+    }
+
+    /**
+     * Whether kernel accumulates density. Detected once per kernel, as it takes a kernel lookup.
+     */
+    template <typename KernelInstanceProperties>
+    bool accumulates(const OpenCLBackendPtr& backend, const KernelId& id) {
+        auto found = accumulatingKernels_.find(id);
+        if (found == accumulatingKernels_.end()) {
+            auto names = backend->compileKernel<KernelInstanceProperties>(id).nameMap();
+            found = accumulatingKernels_.emplace(id, accumulates(names)).first;
+        }
+        return found->second;
+    }
+
+    /**
+     * Hit count of every pixel and maximum of them.
+     */
+    size_t densityBytes() const {
+        auto region = dimensions_.makeRegion();
+        return (region[0] * region[1] * region[2] + 1) * sizeof(cl_uint);
+    }
+
+    /**
+     * Bind density buffer, allocating it if needed. Unlike statistics, density is kept between computations; it
+     * is only zeroed when allocated and by clear().
+     */
+    void bindDensityBuffer(OpenCLBackendPtr backend, const cl::CommandQueue& queue, cl::Kernel kernel, cl_uint arg) {
+        auto ctx = backend->currentContext();
+        if (density_() == NULL || !memoryBelongsToContext(density_, ctx)
+            || density_.getInfo<CL_MEM_SIZE>() < densityBytes()) {
+            pool_->release(density_);
+            density_ = pool_->acquireBuffer(ctx, CL_MEM_READ_WRITE, densityBytes());
+            queue.enqueueFillBuffer(density_, cl_uint { 0 }, 0, densityBytes());
+        }
+        kernel.setArg(arg, density_);
+    }
+
+    /**
+     * Zero and bind statistics buffers, if kernel has arguments for them. Returns false otherwise.
+     */
+    bool bindStatisticsBuffers(OpenCLBackendPtr backend, const cl::CommandQueue& queue, cl::Kernel kernel,
+                               const ArgNameMap& names) {
+        auto statsArg = names.find("stats");
+        auto hitMaskArg = names.find("hit_mask");
+        if (statsArg == names.end() || hitMaskArg == names.end()) {
+            return false;
+        }
+
+        auto ctx = backend->currentContext();
+        auto region = dimensions_.makeRegion();
+        auto hitMaskBytes = RenderStatistics::hitMaskWords(region[0] * region[1] * region[2]) * sizeof(cl_uint);
+        if (statsBuffer_() == NULL || !memoryBelongsToContext(statsBuffer_, ctx)) {
+            pool_->release(statsBuffer_);
+            statsBuffer_ = pool_->acquireBuffer(ctx, CL_MEM_READ_WRITE, sizeof(statsHost_));
+        }
+        if (hitMask_() == NULL || !memoryBelongsToContext(hitMask_, ctx)
+            || hitMask_.getInfo<CL_MEM_SIZE>() < hitMaskBytes) {
+            pool_->release(hitMask_);
+            hitMask_ = pool_->acquireBuffer(ctx, CL_MEM_READ_WRITE, hitMaskBytes);
+        }
+
+        queue.enqueueFillBuffer(statsBuffer_, cl_uint { 0 }, 0, sizeof(statsHost_));
+        queue.enqueueFillBuffer(hitMask_, cl_uint { 0 }, 0, hitMaskBytes);
+        kernel.setArg(statsArg->second, statsBuffer_);
+        kernel.setArg(hitMaskArg->second, hitMask_);
+        return true;
     }
 
     RangeType dimensions_;
+    std::shared_ptr<DeviceMemoryPool> pool_;
+    cl_mem_flags flags_;
     ImageType image_;
 
+    cl::Buffer statsBuffer_, hitMask_, density_;
+    RenderStatistics::DeviceCounters statsHost_ {};
+    cl::Event statsRead_;
+    std::optional<RenderStatistics> statistics_;
+    Color clearColor_ {1.0f, 1.0f, 1.0f, 1.0f};
+    SliceSizer sliceSizer_;
+    std::unordered_map<KernelId, bool> accumulatingKernels_;
+
 };
 
 #endif //FRACTALEXPLORER_COMPUTABLEIMAGE_HPP
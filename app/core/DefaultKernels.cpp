@@ -0,0 +1,30 @@
+#include "DefaultKernels.hpp"
+
+#include "clc/CLC_Sources.hpp"
+
+std::vector<std::pair<KernelId, KernelBase>> defaultKernels() {
+    cl::Program::Sources newton;
+    newton.reserve(4);
+    // TODO abstract?
+    auto stdlib = sourcesRegistry.findById(STDLIB);
+    newton.insert(std::end(newton), stdlib.begin(), stdlib.end());
+    auto newtonSpecific = sourcesRegistry.findById("newton-fractal");
+    newton.insert(std::end(newton), newtonSpecific.begin(), newtonSpecific.end());
+
+    std::vector<std::pair<KernelId, KernelBase>> kernels;
+    // these are pinned by configurations in practice, so inner loop is specialized for them
+    kernels.emplace_back(NEWTON_FRACTAL_ID, KernelBase {
+        newton, { "-DUSE_DOUBLE_PRECISION" }, { "backward", "t", "runs_count" }
+    });
+    kernels.emplace_back(NEWTON_FRACTAL_ACCUMULATE_ID, KernelBase {
+        newton, { "-DUSE_DOUBLE_PRECISION", "-DACCUMULATE" }, { "backward", "t", "runs_count" }
+    });
+    kernels.emplace_back(TONE_MAP_ID, KernelBase { sourcesRegistry.findById("tone-map"), {} });
+    return kernels;
+}
+
+void registerDefaultKernels(OpenCLBackend& backend) {
+    for (auto& [id, base] : defaultKernels()) {
+        backend.registerKernel(id, std::move(base));
+    }
+}
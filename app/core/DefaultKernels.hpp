@@ -0,0 +1,30 @@
+#ifndef FRACTALEXPLORER_DEFAULTKERNELS_HPP
+#define FRACTALEXPLORER_DEFAULTKERNELS_HPP
+
+#include "OpenCLBackend.hpp"
+
+#include <vector>
+
+static const KernelId NEWTON_FRACTAL_ID { "newton_fractal", "default" };
+
+/**
+ * newton_fractal which adds hits into `density` buffer across launches instead of drawing them (see ACCUMULATE).
+ */
+static const KernelId NEWTON_FRACTAL_ACCUMULATE_ID { "newton_fractal", "accumulate" };
+
+/**
+ * Draws density accumulated by kernels like NEWTON_FRACTAL_ACCUMULATE_ID into image.
+ */
+static const KernelId TONE_MAP_ID { "tone_map", "default" };
+
+/**
+ * Kernels shipped with the application, in the form they are registered in backend.
+ */
+std::vector<std::pair<KernelId, KernelBase>> defaultKernels();
+
+/**
+ * Register all of defaultKernels() in given backend.
+ */
+void registerDefaultKernels(OpenCLBackend&);
+
+#endif //FRACTALEXPLORER_DEFAULTKERNELS_HPP
@@ -0,0 +1,173 @@
+#include "DeviceMemoryBudget.hpp"
+
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <limits>
+
+LOGGER()
+
+static constexpr size_t MiB = 1024 * 1024;
+
+DeviceMemoryBudget::DeviceMemoryBudget(size_t limit) : limit_(limit) {
+    usage_.limit = limit;
+}
+
+size_t DeviceMemoryBudget::defaultLimit(const cl::Context& ctx, double fraction) {
+    if (const char* configured = std::getenv("FRACTALEXPLORER_MEMORY_BUDGET_MB"); configured && *configured) {
+        char* end = nullptr;
+        errno = 0;
+        auto megabytes = std::strtoull(configured, &end, 10);
+        if (errno == 0 && *end == '\0' && megabytes > 0 && configured[0] != '-') {
+            return megabytes * MiB;
+        }
+        logger->warn(fmt::format(
+            "Ignoring FRACTALEXPLORER_MEMORY_BUDGET_MB=\"{}\": not a positive number of MiB", configured
+        ));
+    }
+
+    auto smallest = std::numeric_limits<cl_ulong>::max();
+    for (const auto& device : ctx.getInfo<CL_CONTEXT_DEVICES>()) {
+        smallest = std::min(smallest, device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>());
+    }
+    return static_cast<size_t>(static_cast<double>(smallest) * fraction);
+}
+
+void DeviceMemoryBudget::setLimit(size_t limit) {
+    {
+        std::lock_guard lock { mutex_ };
+        limit_ = limit;
+        usage_.limit = limit;
+    }
+    logger->info(fmt::format("Device memory budget set to {} MiB", limit / MiB));
+
+    auto over = [this]() {
+        std::lock_guard lock { mutex_ };
+        return usage_.total > limit_;
+    };
+    while (over() && evictOne()) {}
+}
+
+void DeviceMemoryBudget::charge(DeviceMemoryOwner owner, size_t bytes) {
+    usage_.total += bytes;
+    usage_.byOwner[static_cast<size_t>(owner)] += bytes;
+}
+
+bool DeviceMemoryBudget::evictOne() {
+    Entry entry;
+    {
+        std::lock_guard lock { mutex_ };
+        if (lru_.empty()) {
+            return false;
+        }
+        entry = std::move(lru_.front());
+        lru_.pop_front();
+        entries_.erase(entry.handle);
+        usage_.reclaimable -= entry.bytes;
+    }
+
+    if (entry.evict()) {
+        std::lock_guard lock { mutex_ };
+        usage_.total -= entry.bytes;
+        usage_.byOwner[static_cast<size_t>(entry.owner)] -= entry.bytes;
+        usage_.evicted += entry.bytes;
+    }
+    return true;
+}
+
+void DeviceMemoryBudget::reserve(DeviceMemoryOwner owner, size_t bytes) {
+    while (true) {
+        {
+            std::lock_guard lock { mutex_ };
+            if (usage_.total + bytes <= limit_) {
+                charge(owner, bytes);
+                return;
+            }
+        }
+        if (!evictOne()) {
+            break;
+        }
+    }
+
+    auto err = fmt::format(
+        "Cannot allocate {} KiB of device memory: {}", bytes / 1024, to_string(usage())
+    );
+    logger->warn(err);
+    throw DeviceMemoryExhausted(err);
+}
+
+void DeviceMemoryBudget::account(DeviceMemoryOwner owner, size_t bytes) {
+    while (true) {
+        {
+            std::lock_guard lock { mutex_ };
+            if (usage_.total + bytes <= limit_ || lru_.empty()) {
+                charge(owner, bytes);
+                return;
+            }
+        }
+        evictOne();
+    }
+}
+
+void DeviceMemoryBudget::free(DeviceMemoryOwner owner, size_t bytes) {
+    std::lock_guard lock { mutex_ };
+    usage_.total -= bytes;
+    usage_.byOwner[static_cast<size_t>(owner)] -= bytes;
+}
+
+DeviceMemoryBudget::EntryHandle DeviceMemoryBudget::addReclaimable(
+    DeviceMemoryOwner owner, size_t bytes, std::function<bool()> evict
+) {
+    std::lock_guard lock { mutex_ };
+    auto handle = nextHandle_++;
+    lru_.push_back({ handle, owner, bytes, std::move(evict) });
+    entries_.emplace(handle, std::prev(lru_.end()));
+    usage_.reclaimable += bytes;
+    return handle;
+}
+
+void DeviceMemoryBudget::removeReclaimable(EntryHandle handle) {
+    std::lock_guard lock { mutex_ };
+    auto it = entries_.find(handle);
+    if (it == entries_.end()) {
+        return;
+    }
+    usage_.reclaimable -= it->second->bytes;
+    lru_.erase(it->second);
+    entries_.erase(it);
+}
+
+void DeviceMemoryBudget::touch(EntryHandle handle) {
+    std::lock_guard lock { mutex_ };
+    auto it = entries_.find(handle);
+    if (it != entries_.end()) {
+        lru_.splice(lru_.end(), lru_, it->second);
+    }
+}
+
+size_t DeviceMemoryBudget::evict(size_t bytes) {
+    auto evictedBefore = usage().evicted;
+    size_t freed = 0;
+    while (freed < bytes && evictOne()) {
+        freed = usage().evicted - evictedBefore;
+    }
+    return freed;
+}
+
+DeviceMemoryBudget::Usage DeviceMemoryBudget::usage() const {
+    std::lock_guard lock { mutex_ };
+    return usage_;
+}
+
+std::string to_string(const DeviceMemoryBudget::Usage& usage) {
+    return fmt::format(
+        "{} / {} MiB used (images {} MiB, buffers {} MiB, programs {} KiB; {} MiB reclaimable, {} MiB evicted)",
+        usage.total / MiB, usage.limit / MiB,
+        usage.byOwner[static_cast<size_t>(DeviceMemoryOwner::Image)] / MiB,
+        usage.byOwner[static_cast<size_t>(DeviceMemoryOwner::Buffer)] / MiB,
+        usage.byOwner[static_cast<size_t>(DeviceMemoryOwner::Program)] / 1024,
+        usage.reclaimable / MiB, usage.evicted / MiB
+    );
+}
@@ -0,0 +1,127 @@
+#ifndef FRACTALEXPLORER_DEVICEMEMORYBUDGET_HPP
+#define FRACTALEXPLORER_DEVICEMEMORYBUDGET_HPP
+
+#include "OpenCL.hpp"
+
+#include <array>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Kind of object device memory is allocated for.
+ */
+enum class DeviceMemoryOwner {
+    Image, Buffer, Program
+};
+
+/**
+ * Thrown when an allocation does not fit into the budget even after everything reclaimable was evicted.
+ */
+class DeviceMemoryExhausted : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * Accounting of device memory of a backend.
+ *
+ * Every device allocation is registered here by its owner. Allocations which are not currently in use
+ * (idle pooled images, cached programs) can be registered as reclaimable; when a new allocation does not fit
+ * into the budget, reclaimable entries are evicted in least recently used order.
+ */
+class DeviceMemoryBudget {
+
+public:
+
+    using EntryHandle = uint64_t;
+
+    struct Usage {
+        size_t limit = 0;
+        size_t total = 0;
+        size_t reclaimable = 0;
+        size_t evicted = 0;
+        std::array<size_t, 3> byOwner {};
+    };
+
+    explicit DeviceMemoryBudget(size_t limit);
+
+    /**
+     * Default budget for given context: fraction of the smallest CL_DEVICE_GLOBAL_MEM_SIZE among its devices,
+     * or FRACTALEXPLORER_MEMORY_BUDGET_MB if it is set to a positive number.
+     */
+    static size_t defaultLimit(const cl::Context&, double fraction = 0.75);
+
+    void setLimit(size_t);
+
+    /**
+     * Account allocation, evicting reclaimable entries if needed. Throws DeviceMemoryExhausted and accounts
+     * nothing if allocation still does not fit.
+     */
+    void reserve(DeviceMemoryOwner, size_t bytes);
+
+    /**
+     * Account allocation which has already happened or cannot be refused. Evicts reclaimable entries if needed,
+     * but never throws.
+     */
+    void account(DeviceMemoryOwner, size_t bytes);
+
+    void free(DeviceMemoryOwner, size_t bytes);
+
+    /**
+     * Register allocation as reclaimable. evict is called without any budget locks held, and should free the
+     * memory and return true, or return false if entry is gone already.
+     */
+    EntryHandle addReclaimable(DeviceMemoryOwner, size_t bytes, std::function<bool()> evict);
+
+    /**
+     * Entry is in use again. Its memory stays accounted.
+     */
+    void removeReclaimable(EntryHandle);
+
+    /**
+     * Mark entry as recently used.
+     */
+    void touch(EntryHandle);
+
+    /**
+     * Evict least recently used entries until at least given number of bytes is freed. Returns bytes freed.
+     */
+    size_t evict(size_t bytes);
+
+    Usage usage() const;
+
+private:
+
+    struct Entry {
+        EntryHandle handle;
+        DeviceMemoryOwner owner;
+        size_t bytes;
+        std::function<bool()> evict;
+    };
+
+    size_t limit_;
+
+    Usage usage_;
+
+    EntryHandle nextHandle_ = 0;
+
+    // least recently used first
+    std::list<Entry> lru_;
+
+    std::unordered_map<EntryHandle, std::list<Entry>::iterator> entries_;
+
+    mutable std::mutex mutex_;
+
+    bool evictOne();
+
+    void charge(DeviceMemoryOwner, size_t bytes);
+
+};
+
+std::string to_string(const DeviceMemoryBudget::Usage&);
+
+#endif //FRACTALEXPLORER_DEVICEMEMORYBUDGET_HPP
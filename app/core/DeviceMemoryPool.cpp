@@ -0,0 +1,252 @@
+#include "DeviceMemoryPool.hpp"
+
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <limits>
+
+LOGGER()
+
+static constexpr size_t minimalBufferSize = 64;
+
+/**
+ * Bytes per pixel of supported image formats.
+ */
+static size_t pixelSize(const cl::ImageFormat& format) {
+    size_t channels = format.image_channel_order == CL_RGBA ? 4 : 1;
+    size_t channelSize = format.image_channel_data_type == CL_UNORM_INT8 ? 1 : 4;
+    return channels * channelSize;
+}
+
+static bool isOutOfMemory(const cl::Error& e) {
+    return e.err() == CL_MEM_OBJECT_ALLOCATION_FAILURE || e.err() == CL_OUT_OF_RESOURCES;
+}
+
+size_t DeviceMemoryPool::KeyHash::operator()(const ImageKey& k) const noexcept {
+    size_t h = std::hash<cl_context> {} (k.ctx);
+    h = 31 * h + std::hash<cl_mem_flags> {} (k.flags);
+    h = 31 * h + (static_cast<size_t>(k.order) << 16 | k.type);
+    h = 31 * h + k.width;
+    return 31 * h + k.height;
+}
+
+size_t DeviceMemoryPool::KeyHash::operator()(const BufferKey& k) const noexcept {
+    size_t h = std::hash<cl_context> {} (k.ctx);
+    h = 31 * h + std::hash<cl_mem_flags> {} (k.flags);
+    return 31 * h + k.size;
+}
+
+DeviceMemoryPool::DeviceMemoryPool(std::shared_ptr<DeviceMemoryBudget> budget)
+    : budget_(std::move(budget))
+{}
+
+DeviceMemoryPool::~DeviceMemoryPool() {
+    trim();
+}
+
+size_t DeviceMemoryPool::sizeClass(size_t size) noexcept {
+    size_t cls = minimalBufferSize;
+    while (cls < size) {
+        cls <<= 1;
+    }
+    return cls;
+}
+
+template <typename T, typename Create>
+T DeviceMemoryPool::allocate(DeviceMemoryOwner owner, size_t bytes, Create&& create) {
+    budget_->reserve(owner, bytes);
+    try {
+        try {
+            return create();
+        } catch (const cl::Error& e) {
+            if (!isOutOfMemory(e)) {
+                throw;
+            }
+            // device ran out of memory before budget did: drop everything reclaimable and retry once
+            logger->warn(fmt::format(
+                "Device allocation of {} KiB failed ({}), evicting all reclaimable memory", bytes / 1024, e.err()
+            ));
+            budget_->evict(std::numeric_limits<size_t>::max());
+            return create();
+        }
+    } catch (const cl::Error& e) {
+        budget_->free(owner, bytes);
+        if (!isOutOfMemory(e)) {
+            throw;
+        }
+        auto err = fmt::format("Device is out of memory allocating {} KiB: {}", bytes / 1024, to_string(budget_->usage()));
+        logger->warn(err);
+        throw DeviceMemoryExhausted(err);
+    }
+}
+
+template <typename Key, typename T>
+bool DeviceMemoryPool::evictPooled(
+    std::unordered_map<Key, std::vector<PooledObject<T>>, KeyHash>& pool, const Key& key,
+    cl_mem memory, size_t bytes
+) {
+    std::lock_guard lock { mutex_ };
+    auto it = pool.find(key);
+    if (it == pool.end()) {
+        return false;
+    }
+    auto& objects = it->second;
+    auto found = std::find_if(objects.begin(), objects.end(), [memory](const auto& o) { return o.object() == memory; });
+    if (found == objects.end()) {
+        return false;
+    }
+    objects.erase(found);
+    --stats_.pooledObjects;
+    stats_.pooledBytes -= bytes;
+    stats_.allocatedBytes -= bytes;
+    return true;
+}
+
+cl::Image2D DeviceMemoryPool::acquireImage2D(
+    const cl::Context& ctx, cl_mem_flags flags, cl::ImageFormat format, size_t width, size_t height
+) {
+    ImageKey key { ctx(), flags, format.image_channel_order, format.image_channel_data_type, width, height };
+    auto bytes = width * height * pixelSize(format);
+    {
+        std::unique_lock lock { mutex_ };
+        auto it = freeImages_.find(key);
+        if (it != freeImages_.end() && !it->second.empty()) {
+            auto pooled = std::move(it->second.back());
+            it->second.pop_back();
+            ++stats_.reuses;
+            --stats_.pooledObjects;
+            stats_.pooledBytes -= bytes;
+            lock.unlock();
+            budget_->removeReclaimable(pooled.handle);
+            return pooled.object;
+        }
+    }
+
+    auto image = allocate<cl::Image2D>(DeviceMemoryOwner::Image, bytes, [&]() {
+        return cl::Image2D { ctx, flags, format, width, height };
+    });
+    {
+        std::lock_guard lock { mutex_ };
+        ++stats_.allocations;
+        stats_.allocatedBytes += bytes;
+    }
+    logger->info(fmt::format("Allocated {}x{} device image; {}", width, height, to_string(statistics())));
+    return image;
+}
+
+cl::Buffer DeviceMemoryPool::acquireBuffer(const cl::Context& ctx, cl_mem_flags flags, size_t size) {
+    BufferKey key { ctx(), flags, sizeClass(size) };
+    {
+        std::unique_lock lock { mutex_ };
+        auto it = freeBuffers_.find(key);
+        if (it != freeBuffers_.end() && !it->second.empty()) {
+            auto pooled = std::move(it->second.back());
+            it->second.pop_back();
+            ++stats_.reuses;
+            --stats_.pooledObjects;
+            stats_.pooledBytes -= key.size;
+            lock.unlock();
+            budget_->removeReclaimable(pooled.handle);
+            return pooled.object;
+        }
+    }
+
+    auto buffer = allocate<cl::Buffer>(DeviceMemoryOwner::Buffer, key.size, [&]() {
+        return cl::Buffer { ctx, flags, key.size };
+    });
+    {
+        std::lock_guard lock { mutex_ };
+        ++stats_.allocations;
+        stats_.allocatedBytes += key.size;
+    }
+    logger->info(fmt::format("Allocated device buffer of {} bytes; {}", key.size, to_string(statistics())));
+    return buffer;
+}
+
+void DeviceMemoryPool::release(cl::Image2D image) {
+    if (image() == nullptr) {
+        return;
+    }
+    cl::ImageFormat format;
+    static_cast<cl_image_format&>(format) = image.getImageInfo<CL_IMAGE_FORMAT>();
+    ImageKey key {
+        image.getInfo<CL_MEM_CONTEXT>()(), image.getInfo<CL_MEM_FLAGS>(),
+        format.image_channel_order, format.image_channel_data_type,
+        image.getImageInfo<CL_IMAGE_WIDTH>(), image.getImageInfo<CL_IMAGE_HEIGHT>()
+    };
+    auto bytes = key.width * key.height * pixelSize(format);
+    cl_mem memory = image();
+
+    // budget never calls back while holding its own lock, so entry can be registered under pool lock
+    std::lock_guard lock { mutex_ };
+    auto handle = budget_->addReclaimable(DeviceMemoryOwner::Image, bytes, [this, key, memory, bytes]() {
+        return evictPooled(freeImages_, key, memory, bytes);
+    });
+    freeImages_[key].push_back({ std::move(image), handle });
+    ++stats_.releases;
+    ++stats_.pooledObjects;
+    stats_.pooledBytes += bytes;
+}
+
+void DeviceMemoryPool::release(cl::Buffer buffer) {
+    if (buffer() == nullptr) {
+        return;
+    }
+    BufferKey key { buffer.getInfo<CL_MEM_CONTEXT>()(), buffer.getInfo<CL_MEM_FLAGS>(), buffer.getInfo<CL_MEM_SIZE>() };
+    cl_mem memory = buffer();
+
+    std::lock_guard lock { mutex_ };
+    auto handle = budget_->addReclaimable(DeviceMemoryOwner::Buffer, key.size, [this, key, memory]() {
+        return evictPooled(freeBuffers_, key, memory, key.size);
+    });
+    freeBuffers_[key].push_back({ std::move(buffer), handle });
+    ++stats_.releases;
+    ++stats_.pooledObjects;
+    stats_.pooledBytes += key.size;
+}
+
+size_t DeviceMemoryPool::trim() {
+    std::vector<DeviceMemoryBudget::EntryHandle> handles;
+    size_t freedImages = 0, freedBuffers = 0;
+    {
+        std::lock_guard lock { mutex_ };
+        for (auto& [key, images] : freeImages_) {
+            freedImages += images.size() * key.width * key.height
+                * pixelSize(cl::ImageFormat { key.order, key.type });
+            for (const auto& pooled : images) {
+                handles.push_back(pooled.handle);
+            }
+        }
+        for (auto& [key, buffers] : freeBuffers_) {
+            freedBuffers += buffers.size() * key.size;
+            for (const auto& pooled : buffers) {
+                handles.push_back(pooled.handle);
+            }
+        }
+        freeImages_.clear();
+        freeBuffers_.clear();
+        stats_.allocatedBytes -= stats_.pooledBytes;
+        stats_.pooledObjects = 0;
+        stats_.pooledBytes = 0;
+    }
+
+    for (auto handle : handles) {
+        budget_->removeReclaimable(handle);
+    }
+    budget_->free(DeviceMemoryOwner::Image, freedImages);
+    budget_->free(DeviceMemoryOwner::Buffer, freedBuffers);
+    return freedImages + freedBuffers;
+}
+
+DeviceMemoryPool::Statistics DeviceMemoryPool::statistics() const {
+    std::lock_guard lock { mutex_ };
+    return stats_;
+}
+
+std::string to_string(const DeviceMemoryPool::Statistics& stats) {
+    return fmt::format(
+        "pool: {} allocations ({} KiB live), {} reuses, {} releases, {} pooled ({} KiB)",
+        stats.allocations, stats.allocatedBytes / 1024, stats.reuses, stats.releases,
+        stats.pooledObjects, stats.pooledBytes / 1024
+    );
+}
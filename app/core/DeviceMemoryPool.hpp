@@ -0,0 +1,129 @@
+#ifndef FRACTALEXPLORER_DEVICEMEMORYPOOL_HPP
+#define FRACTALEXPLORER_DEVICEMEMORYPOOL_HPP
+
+#include "OpenCL.hpp"
+
+#include "DeviceMemoryBudget.hpp"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Pool of device images and buffers. Released objects are kept alive and handed out again for matching
+ * requests, so that steady-state frame loop makes no device allocations.
+ *
+ * Images are matched by context, flags, format and dimensions; buffers by context, flags and size class
+ * (sizes are rounded up to the next power of two).
+ *
+ * Allocations are accounted in DeviceMemoryBudget; idle pooled objects are reclaimable. Objects acquired from
+ * the pool must be released back to it, otherwise their memory stays accounted.
+ */
+class DeviceMemoryPool {
+
+public:
+
+    explicit DeviceMemoryPool(std::shared_ptr<DeviceMemoryBudget> budget);
+
+    ~DeviceMemoryPool();
+
+    DeviceMemoryPool(const DeviceMemoryPool&) = delete;
+    DeviceMemoryPool& operator=(const DeviceMemoryPool&) = delete;
+
+    struct Statistics {
+        size_t allocations = 0;
+        size_t allocatedBytes = 0;
+        size_t reuses = 0;
+        size_t releases = 0;
+        size_t pooledObjects = 0;
+        size_t pooledBytes = 0;
+    };
+
+    /**
+     * Throws DeviceMemoryExhausted if image does not fit into the budget or device is out of memory.
+     */
+    cl::Image2D acquireImage2D(
+        const cl::Context&, cl_mem_flags, cl::ImageFormat, size_t width, size_t height);
+
+    cl::Buffer acquireBuffer(const cl::Context&, cl_mem_flags, size_t size);
+
+    /**
+     * Return image to the pool. Null images are ignored.
+     */
+    void release(cl::Image2D);
+
+    /**
+     * Return buffer to the pool. Null buffers are ignored.
+     */
+    void release(cl::Buffer);
+
+    /**
+     * Free all pooled objects. Returns number of bytes freed.
+     */
+    size_t trim();
+
+    Statistics statistics() const;
+
+    inline DeviceMemoryBudget& budget() noexcept { return *budget_; }
+
+    static size_t sizeClass(size_t size) noexcept;
+
+private:
+
+    struct ImageKey {
+        cl_context ctx;
+        cl_mem_flags flags;
+        cl_channel_order order;
+        cl_channel_type type;
+        size_t width, height;
+
+        bool operator==(const ImageKey& o) const {
+            return ctx == o.ctx && flags == o.flags && order == o.order && type == o.type
+                && width == o.width && height == o.height;
+        }
+    };
+
+    struct BufferKey {
+        cl_context ctx;
+        cl_mem_flags flags;
+        size_t size;
+
+        bool operator==(const BufferKey& o) const {
+            return ctx == o.ctx && flags == o.flags && size == o.size;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const ImageKey& k) const noexcept;
+        size_t operator()(const BufferKey& k) const noexcept;
+    };
+
+    template <typename T>
+    struct PooledObject {
+        T object;
+        DeviceMemoryBudget::EntryHandle handle;
+    };
+
+    std::shared_ptr<DeviceMemoryBudget> budget_;
+
+    std::unordered_map<ImageKey, std::vector<PooledObject<cl::Image2D>>, KeyHash> freeImages_;
+    std::unordered_map<BufferKey, std::vector<PooledObject<cl::Buffer>>, KeyHash> freeBuffers_;
+
+    mutable std::mutex mutex_;
+
+    Statistics stats_;
+
+    template <typename Key, typename T>
+    bool evictPooled(std::unordered_map<Key, std::vector<PooledObject<T>>, KeyHash>&, const Key&,
+                     cl_mem, size_t bytes);
+
+    template <typename T, typename Create>
+    T allocate(DeviceMemoryOwner, size_t bytes, Create&&);
+
+};
+
+std::string to_string(const DeviceMemoryPool::Statistics&);
+
+#endif //FRACTALEXPLORER_DEVICEMEMORYPOOL_HPP
@@ -0,0 +1,297 @@
+#include "DeviceProbe.hpp"
+
+#include "ProgramBinaryCache.hpp"
+#include "RenderStatistics.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+LOGGER()
+
+static constexpr std::string_view ATOMICS_PROBE_SOURCE { R"CL(
+kernel void probe_atomics(global uint* counters, uint iterations) {
+    global uint* counter = counters + (get_global_id(0) & 15);
+    for (uint i = 0; i < iterations; ++i) {
+        atomic_inc(counter);
+    }
+}
+)CL" };
+
+static constexpr size_t probeImageSize = 64;
+static constexpr double probeTargetSeconds = 0.05;
+static constexpr int32_t probeMaxPoints = 8192;
+
+static constexpr size_t atomicsGlobalSize = 4096;
+static constexpr cl_uint atomicsIterations = 64;
+
+/**
+ * Lower bound of a measured launch, so that rates stay finite.
+ */
+static constexpr double minMeasuredSeconds = 1e-6;
+
+/**
+ * Waits for launch and returns its duration. Some devices have timers too coarse to time a short launch; host
+ * time of the launch is used for them instead.
+ */
+static double launchSeconds(const cl::Event& event, std::chrono::steady_clock::time_point enqueued) {
+    event.wait();
+    auto hostSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - enqueued).count();
+    auto start = event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+    auto end = event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+    auto deviceSeconds = end > start ? (end - start) * 1e-9 : hostSeconds;
+    return std::max(deviceSeconds, minMeasuredSeconds);
+}
+
+KernelArgs newtonFractalProbeArgs(int32_t pointsCount) {
+    return {
+        { std::string { "min_x" }, KernelArgValue { -2.0 } },
+        { std::string { "max_x" }, KernelArgValue { 2.0 } },
+        { std::string { "min_y" }, KernelArgValue { -2.0 } },
+        { std::string { "max_y" }, KernelArgValue { 2.0 } },
+        { std::string { "C" }, KernelArgValue { 0.5, -0.5 } },
+        { std::string { "backward" }, KernelArgValue { 1 } },
+        { std::string { "t" }, KernelArgValue { 1 } },
+        { std::string { "h" }, KernelArgValue { 1.0 } },
+        { std::string { "runs_count" }, KernelArgValue { 1 } },
+        { std::string { "points_count" }, KernelArgValue { pointsCount } },
+        { std::string { "iter_skip" }, KernelArgValue { 0 } },
+        { std::string { "seed" }, KernelArgValue { int64_t { 1 } } },
+        { std::string { "color_in" }, KernelArgValue { 0.0f, 0.0f, 0.0f } },
+    };
+}
+
+/**
+ * Run newton_fractal with growing points_count, until a single launch takes at least probeTargetSeconds.
+ */
+static double probeNewtonFractal(
+    const KernelBase& base, const cl::Context& ctx, const cl::CommandQueue& queue, ProgramBinaryCache& cache
+) {
+    cl::Kernel kernel { cache.build(base, ctx), "newton_fractal" };
+    cl::Image2D image { ctx, CL_MEM_READ_WRITE, { CL_RGBA, CL_UNORM_INT8 }, probeImageSize, probeImageSize };
+
+    auto types = detectArgumentTypesAndNames(kernel);
+    auto args = newtonFractalProbeArgs(0);
+    auto names = mapNamesToArgIndices(kernel);
+    kernel.setArg(detectImageArgIdx(names), image);
+
+    // kernel abandons some trajectories early, so throughput is counted from generated points it reports
+    auto statsSize = sizeof(RenderStatistics::DeviceCounters);
+    auto hitMaskSize = RenderStatistics::hitMaskWords(probeImageSize * probeImageSize) * sizeof(cl_uint);
+    cl::Buffer stats { ctx, CL_MEM_READ_WRITE, statsSize };
+    cl::Buffer hitMask { ctx, CL_MEM_READ_WRITE, hitMaskSize };
+    queue.enqueueFillBuffer(hitMask, cl_uint { 0 }, 0, hitMaskSize);
+    if (auto arg = names.find("stats"); arg != names.end()) {
+        kernel.setArg(arg->second, stats);
+    }
+    if (auto arg = names.find("hit_mask"); arg != names.end()) {
+        kernel.setArg(arg->second, hitMask);
+    }
+
+    int32_t points = 64;
+    double seconds;
+    RenderStatistics::DeviceCounters counters;
+    while (true) {
+        args[std::string { "points_count" }] = KernelArgValue { points };
+        auto converted = convertArgs(types, args);
+        applyArgsToKernel(kernel, converted.begin(), converted.end());
+
+        queue.enqueueFillBuffer(stats, cl_uint { 0 }, 0, statsSize);
+        cl::Event event;
+        auto enqueued = std::chrono::steady_clock::now();
+        queue.enqueueNDRangeKernel(
+            kernel, cl::NullRange, { probeImageSize, probeImageSize }, cl::NullRange, nullptr, &event
+        );
+        seconds = launchSeconds(event, enqueued);
+        queue.enqueueReadBuffer(stats, CL_TRUE, 0, statsSize, counters.data());
+
+        if (seconds >= probeTargetSeconds || points >= probeMaxPoints) {
+            break;
+        }
+        points *= 2;
+    }
+
+    return static_cast<double>(RenderStatistics::fromDeviceCounters(counters).pointsGenerated) / seconds;
+}
+
+static double probeAtomics(const cl::Context& ctx, const cl::CommandQueue& queue) {
+    KernelBase base { { { ATOMICS_PROBE_SOURCE.data(), ATOMICS_PROBE_SOURCE.size() } }, {} };
+    cl::Kernel kernel { base.build(ctx), "probe_atomics" };
+    cl::Buffer counters { ctx, CL_MEM_READ_WRITE, 16 * sizeof(cl_uint) };
+
+    queue.enqueueFillBuffer(counters, cl_uint { 0 }, 0, 16 * sizeof(cl_uint));
+    kernel.setArg(0, counters);
+    kernel.setArg(1, atomicsIterations);
+
+    cl::Event event;
+    auto enqueued = std::chrono::steady_clock::now();
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, { atomicsGlobalSize }, cl::NullRange, nullptr, &event);
+
+    return atomicsGlobalSize * static_cast<double>(atomicsIterations) / launchSeconds(event, enqueued);
+}
+
+bool openCLAvailable() {
+    try {
+        std::vector<cl::Platform> platforms;
+        cl::Platform::get(&platforms);
+        return !platforms.empty();
+    } catch (const cl::Error& e) {
+        logger->warn(fmt::format("No OpenCL platforms available: {} ({})", e.what(), e.err()));
+        return false;
+    }
+}
+
+static std::vector<DeviceProbeResult> enumerateDevices() {
+    std::vector<DeviceProbeResult> result;
+
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+    for (const auto& platform : platforms) {
+        std::vector<cl::Device> devices;
+        try {
+            platform.getDevices(CL_DEVICE_TYPE_ALL, &devices);
+        } catch (const cl::Error&) {
+            continue;
+        }
+        for (const auto& device : devices) {
+            DeviceProbeResult res;
+            res.device = device;
+            res.name = fmt::format("{} / {}", platform.getInfo<CL_PLATFORM_NAME>(), device.getInfo<CL_DEVICE_NAME>());
+            res.fp64 = device.getInfo<CL_DEVICE_EXTENSIONS>().find("cl_khr_fp64") != std::string::npos;
+            // query fails on 1.1 devices without fp64
+            if (res.fp64) {
+                res.fp64Config = device.getInfo<CL_DEVICE_DOUBLE_FP_CONFIG>();
+            }
+            result.push_back(std::move(res));
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Identifies set of devices and their drivers.
+ */
+static uint64_t devicesFingerprint(const std::vector<DeviceProbeResult>& devices) {
+    std::string key;
+    for (const auto& res : devices) {
+        key.append(res.name);
+        key.append(res.device.getInfo<CL_DRIVER_VERSION>());
+        key.push_back('\0');
+    }
+    return contentHash(key);
+}
+
+static bool loadResults(const std::filesystem::path& file, uint64_t fingerprint, std::vector<DeviceProbeResult>& devices) {
+    std::ifstream in { file };
+    if (!in) {
+        return false;
+    }
+
+    std::string line, word;
+    uint64_t storedFingerprint;
+    while (std::getline(in, line) && (line.empty() || line[0] == '#')) {}
+    std::istringstream header { line };
+    if (!(header >> word >> std::hex >> storedFingerprint) || word != "fingerprint" || storedFingerprint != fingerprint) {
+        return false;
+    }
+
+    for (auto& res : devices) {
+        if (!std::getline(in, line)) {
+            return false;
+        }
+        std::istringstream entry { line };
+        if (!(entry >> res.pointsPerSecond >> res.atomicsPerSecond)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void storeResults(const std::filesystem::path& file, uint64_t fingerprint, const std::vector<DeviceProbeResult>& devices) {
+    std::error_code ec;
+    std::filesystem::create_directories(file.parent_path(), ec);
+
+    // other processes read this file concurrently, so it is replaced as a whole
+    auto tmpPath = file;
+    tmpPath += fmt::format(".{:x}.{:x}.tmp",
+        std::hash<std::thread::id> {} (std::this_thread::get_id()),
+        std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+        std::ofstream out { tmpPath, std::ios::trunc };
+        out << "# <points per second> <atomics per second> <device>\n";
+        out << "fingerprint " << std::hex << fingerprint << std::dec << '\n';
+        for (const auto& res : devices) {
+            out << res.pointsPerSecond << ' ' << res.atomicsPerSecond << ' ' << res.name << '\n';
+        }
+        if (!out) {
+            logger->warn(fmt::format("Failed to write device probe results to {}", tmpPath.string()));
+            std::filesystem::remove(tmpPath, ec);
+            return;
+        }
+    }
+
+    std::filesystem::rename(tmpPath, file, ec);
+    if (ec) {
+        logger->warn(fmt::format("Failed to store device probe results to {}: {}", file.string(), ec.message()));
+        std::filesystem::remove(tmpPath, ec);
+    }
+}
+
+std::optional<std::vector<DeviceProbeResult>> cachedDeviceProbe(const std::filesystem::path& resultsFile) {
+    auto devices = enumerateDevices();
+    if (!loadResults(resultsFile, devicesFingerprint(devices), devices)) {
+        return std::nullopt;
+    }
+    logger->info(fmt::format("Device probe results loaded from {}", resultsFile.string()));
+    return devices;
+}
+
+std::vector<DeviceProbeResult> probeDevices(
+    const KernelBase& newtonFractal, const std::filesystem::path& resultsFile, bool force
+) {
+    auto devices = enumerateDevices();
+    auto fingerprint = devicesFingerprint(devices);
+
+    if (!force && loadResults(resultsFile, fingerprint, devices)) {
+        logger->info(fmt::format("Device probe results loaded from {}", resultsFile.string()));
+    } else {
+        logger->info(fmt::format("Probing {} OpenCL device(s)...", devices.size()));
+        ProgramBinaryCache cache { cacheDirectory() / "programs" };
+        for (auto& res : devices) {
+            try {
+                cl::Context ctx { res.device };
+                cl::CommandQueue queue { ctx, res.device, CL_QUEUE_PROFILING_ENABLE };
+                res.pointsPerSecond = probeNewtonFractal(newtonFractal, ctx, queue, cache);
+                res.atomicsPerSecond = probeAtomics(ctx, queue);
+            } catch (const std::exception& e) {
+                logger->warn(fmt::format("Device {} failed to run probe: {}", res.name, e.what()));
+                res.pointsPerSecond = res.atomicsPerSecond = 0;
+            }
+        }
+        storeResults(resultsFile, fingerprint, devices);
+    }
+
+    for (const auto& res : devices) {
+        logger->info(fmt::format(
+            "Device {}: {:.3g} points/s, {:.3g} atomics/s, fp64 {} (config {:#x})",
+            res.name, res.pointsPerSecond, res.atomicsPerSecond, res.fp64 ? "yes" : "no", res.fp64Config
+        ));
+    }
+
+    return devices;
+}
+
+const DeviceProbeResult& fastestDevice(const std::vector<DeviceProbeResult>& results) {
+    auto it = std::max_element(results.begin(), results.end(), [](const auto& a, const auto& b) {
+        return a.pointsPerSecond < b.pointsPerSecond;
+    });
+    if (it == results.end()) {
+        auto err = "No OpenCL devices found";
+        logger->error(err);
+        throw std::runtime_error(err);
+    }
+    return *it;
+}
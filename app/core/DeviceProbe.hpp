@@ -0,0 +1,61 @@
+#ifndef FRACTALEXPLORER_DEVICEPROBE_HPP
+#define FRACTALEXPLORER_DEVICEPROBE_HPP
+
+#include "OpenCL.hpp"
+#include "OpenCLKernelUtils.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+/**
+ * Measured capabilities of a single OpenCL device.
+ */
+struct DeviceProbeResult {
+    cl::Device device;
+    std::string name;
+
+    /**
+     * Points computed per second by calibrated newton_fractal workload. Zero if probe failed.
+     */
+    double pointsPerSecond = 0;
+
+    /**
+     * Global atomic increments per second.
+     */
+    double atomicsPerSecond = 0;
+
+    bool fp64 = false;
+    cl_device_fp_config fp64Config = 0;
+};
+
+/**
+ * Whether OpenCL can be used at all. Without ICD loader or installed drivers there are no platforms.
+ */
+bool openCLAvailable();
+
+/**
+ * Arguments of calibrated newton_fractal workload, without memory objects.
+ */
+KernelArgs newtonFractalProbeArgs(int32_t pointsCount);
+
+/**
+ * Measure every available device with given newton_fractal kernel. Results are persisted in resultsFile and
+ * reused on subsequent calls unless set of devices (or their drivers) has changed, or force is set. Nothing else
+ * should be running on devices meanwhile, persisted results are trusted on every later start.
+ */
+std::vector<DeviceProbeResult> probeDevices(
+    const KernelBase& newtonFractal, const std::filesystem::path& resultsFile, bool force = false);
+
+/**
+ * Results persisted by probeDevices, if they are still valid for current devices. Never runs the probe, so it is
+ * cheap enough for startup.
+ */
+std::optional<std::vector<DeviceProbeResult>> cachedDeviceProbe(const std::filesystem::path& resultsFile);
+
+/**
+ * Device with the highest points per second.
+ */
+const DeviceProbeResult& fastestDevice(const std::vector<DeviceProbeResult>&);
+
+#endif //FRACTALEXPLORER_DEVICEPROBE_HPP
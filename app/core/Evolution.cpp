@@ -0,0 +1,124 @@
+#include "Evolution.hpp"
+
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+
+LOGGER()
+
+Evolution::Evolution(ArgsTypesWithNames argTypes) : argTypes_(std::move(argTypes)) {}
+
+Evolution Evolution::fromConfig(ArgsTypesWithNames argTypes, std::string_view conf) {
+    Evolution evolution { std::move(argTypes) };
+    const auto& types = evolution.argTypes_;
+
+    std::istringstream lines { std::string { conf } };
+    std::string lineStr;
+    size_t line = 0;
+    while (std::getline(lines, lineStr)) {
+        ++line;
+        absl::StripAsciiWhitespace(&lineStr);
+        if (lineStr.empty()) {
+            continue;
+        }
+
+        std::istringstream ss { lineStr };
+        size_t frame;
+        std::string arg;
+        if (!(ss >> frame >> arg)) {
+            auto err = fmt::format("L{}: expected <frame> <name|index> <component>...", line);
+            logger->error(err);
+            throw PropertyParsingError(err);
+        }
+
+        size_t index;
+        if (std::all_of(arg.begin(), arg.end(), [](unsigned char c) { return std::isdigit(c); })) {
+            // out of range index is reported as unknown argument below
+            auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), index);
+            if (ec != std::errc {} || end != arg.data() + arg.size()) {
+                index = types.size();
+            }
+        } else {
+            auto it = std::find_if(types.begin(), types.end(), [&arg](const auto& t) { return t.second == arg; });
+            index = static_cast<size_t>(std::distance(types.begin(), it));
+        }
+        if (index >= types.size() || findTypeTraits(types[index].first).klass == KernelArgTypeClass::Memory) {
+            auto err = fmt::format("L{}: '{}' is not a value argument of this kernel", line, arg);
+            logger->error(err);
+            throw PropertyParsingError(err);
+        }
+
+        std::vector<Primitive> components(findTypeTraits(types[index].first).numComponents);
+        for (auto& component : components) {
+            if (!(ss >> component)) {
+                auto err = fmt::format(
+                    "L{}: expected {} component(s) for argument '{}'", line, components.size(), types[index].second
+                );
+                logger->error(err);
+                throw PropertyParsingError(err);
+            }
+        }
+        evolution.addKeyframe(frame, index, std::move(components));
+    }
+
+    return evolution;
+}
+
+void Evolution::addKeyframe(size_t frame, size_t argIndex, std::vector<Primitive> components) {
+    auto& track = tracks_[argIndex];
+    auto it = std::lower_bound(track.begin(), track.end(), frame, [](const Keyframe& k, size_t f) {
+        return k.frame < f;
+    });
+    if (it != track.end() && it->frame == frame) {
+        it->components = std::move(components);
+    } else {
+        track.insert(it, { frame, std::move(components) });
+    }
+}
+
+size_t Evolution::lastKeyframe() const {
+    size_t last = 0;
+    for (const auto& [index, track] : tracks_) {
+        last = std::max(last, track.back().frame);
+    }
+    return last;
+}
+
+KernelArgs Evolution::argsAt(size_t frame, const KernelArgs& base) const {
+    KernelArgs args = base;
+    for (const auto& [index, track] : tracks_) {
+        const auto& [type, name] = argTypes_[index];
+        auto traits = findTypeTraits(type);
+
+        auto next = std::lower_bound(track.begin(), track.end(), frame, [](const Keyframe& k, size_t f) {
+            return k.frame < f;
+        });
+        std::vector<Primitive> components;
+        if (next == track.begin()) {
+            components = next->components;
+        } else if (next == track.end()) {
+            components = track.back().components;
+        } else {
+            auto prev = std::prev(next);
+            auto t = static_cast<double>(frame - prev->frame) / static_cast<double>(next->frame - prev->frame);
+            components.resize(traits.numComponents);
+            for (size_t i = 0; i < components.size(); ++i) {
+                components[i] = prev->components[i] + (next->components[i] - prev->components[i]) * t;
+            }
+        }
+        if (traits.klass == KernelArgTypeClass::Integer) {
+            for (auto& component : components) {
+                component = std::round(component);
+            }
+        }
+
+        // base may key this argument either way; the evolving value replaces both
+        args.erase(name);
+        args.erase(index);
+        args[name] = traits.fromVector(components);
+    }
+    return args;
+}
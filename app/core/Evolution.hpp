@@ -1,4 +1,55 @@
 #ifndef FRACTALEXPLORER_EVOLUTION_HPP
 #define FRACTALEXPLORER_EVOLUTION_HPP
 
+#include "OpenCLKernelUtils.hpp"
+
+#include <map>
+#include <string_view>
+#include <vector>
+
+/**
+ * Kernel arguments changing along a keyframed path. Between keyframes of an argument its components are
+ * interpolated linearly (and rounded for integer types); before the first and after the last keyframe the value
+ * is held. Arguments without keyframes keep their base values.
+ */
+class Evolution {
+
+    struct Keyframe {
+        size_t frame;
+        std::vector<Primitive> components;
+    };
+
+    ArgsTypesWithNames argTypes_;
+
+    /**
+     * Keyframes of every evolving argument by its index, sorted by frame.
+     */
+    std::map<size_t, std::vector<Keyframe>> tracks_;
+
+public:
+
+    explicit Evolution(ArgsTypesWithNames argTypes);
+
+    /**
+     * Parse keyframes, one per line: <frame> <name|index> <component>...
+     */
+    static Evolution fromConfig(ArgsTypesWithNames argTypes, std::string_view conf);
+
+    /**
+     * Set value of argument at given frame, replacing keyframe of that frame if there is one.
+     */
+    void addKeyframe(size_t frame, size_t argIndex, std::vector<Primitive> components);
+
+    /**
+     * The last frame at which some argument has a keyframe.
+     */
+    size_t lastKeyframe() const;
+
+    /**
+     * Base args with evolving arguments replaced by their values at given frame.
+     */
+    KernelArgs argsAt(size_t frame, const KernelArgs& base) const;
+
+};
+
 #endif //FRACTALEXPLORER_EVOLUTION_HPP
@@ -0,0 +1,54 @@
+#include "ImageEngine.hpp"
+
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <thread>
+
+LOGGER()
+
+std::chrono::nanoseconds measureFrameTime(
+    ImageEngine& engine, const KernelArgs& args, size_t numPixels, size_t runs
+) {
+    while (!engine.ready()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::vector<uint32_t> pixels(numPixels);
+    std::vector<std::chrono::nanoseconds> times;
+    // the first run pays for allocations and warm-up
+    for (size_t i = 0; i <= runs; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        engine.compute(args);
+        engine.read(pixels.data());
+        times.push_back(std::chrono::steady_clock::now() - start);
+    }
+    times.erase(times.begin());
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    return times[times.size() / 2];
+}
+
+ImageEnginePtr fastestEngine(
+    const std::vector<ImageEnginePtr>& engines, const KernelArgs& args, size_t numPixels
+) {
+    ImageEnginePtr fastest;
+    auto fastestTime = std::chrono::nanoseconds::max();
+    for (const auto& engine : engines) {
+        try {
+            auto time = measureFrameTime(*engine, args, numPixels);
+            logger->info(fmt::format("Engine {} computes frame in {:.2f} ms", engine->name(), time.count() * 1e-6));
+            if (time < fastestTime) {
+                fastest = engine;
+                fastestTime = time;
+            }
+        } catch (const std::exception& e) {
+            logger->warn(fmt::format("Engine {} failed to compute a frame: {}", engine->name(), e.what()));
+        }
+    }
+    if (!fastest) {
+        auto err = std::string("None of engines can compute a frame");
+        logger->error(err);
+        throw std::runtime_error(err);
+    }
+    return fastest;
+}
@@ -0,0 +1,99 @@
+#ifndef FRACTALEXPLORER_IMAGEENGINE_HPP
+#define FRACTALEXPLORER_IMAGEENGINE_HPP
+
+#include "OpenCLKernelUtils.hpp"
+#include "RenderStatistics.hpp"
+#include "SlicedDispatch.hpp"
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <vector>
+
+/**
+ * Image in host memory, accessed in place. Rows are rowLength pixels apart, which may be more than image width.
+ */
+struct MappedImage {
+    const uint32_t* pixels;
+    size_t rowLength;
+};
+
+/**
+ * Computes 2D RGBA images of a single algorithm from its arguments. UI and batch code only use this interface,
+ * so that images can be computed with OpenCL (see OpenCLImageEngine) as well as without it.
+ */
+class ImageEngine {
+public:
+
+    virtual ~ImageEngine() = default;
+
+    /**
+     * Short name, e.g. "opencl", for logs.
+     */
+    virtual std::string name() const = 0;
+
+    /**
+     * Whether engine is prepared (e.g. kernel is compiled), so that argTypes() and compute() do not block on it.
+     */
+    virtual bool ready() = 0;
+
+    /**
+     * Types and names of algorithm arguments. Args passed to compute() are keyed by these names or by indices.
+     * Throws if engine cannot be prepared.
+     */
+    virtual ArgsTypesWithNames argTypes() = 0;
+
+    virtual void resize(size_t width, size_t height) = 0;
+
+    /**
+     * Compute subsequent images in slices, so that they report progress and can be cancelled (see SlicedDispatch).
+     * Once cancelled, compute() or refine() returns early and image is left incomplete. Engines which cannot slice
+     * their work ignore this.
+     */
+    virtual void setSlicedDispatch(std::optional<SlicedDispatch>) {}
+
+    /**
+     * Clear image to white and compute it. Returns once image is computed.
+     */
+    virtual void compute(const KernelArgs&) = 0;
+
+    /**
+     * Add another pass to the last computed image: same args, new random points. Returns false if engine does not
+     * accumulate passes (or nothing was computed since resize()), in which case image is unchanged, and if the
+     * pass was cancelled; image cannot be refined further then.
+     */
+    virtual bool refine() { return false; }
+
+    /**
+     * Copy last computed image into pixels, which must hold width * height RGBA8 values.
+     */
+    virtual void read(uint32_t* pixels) = 0;
+
+    /**
+     * Access last computed image without copying it, if engine keeps it in host memory. Mapping stays valid until
+     * unmap(), compute() or resize(). Engines which cannot do this return nullopt; read() is used then.
+     */
+    virtual std::optional<MappedImage> map() { return std::nullopt; }
+
+    virtual void unmap() {}
+
+    /**
+     * Statistics of the last computation, if algorithm collects them.
+     */
+    virtual std::optional<RenderStatistics> statistics() = 0;
+
+};
+
+using ImageEnginePtr = std::shared_ptr<ImageEngine>;
+
+/**
+ * Median time of computing and reading back an image of numPixels with given args. Waits until engine is ready.
+ */
+std::chrono::nanoseconds measureFrameTime(ImageEngine&, const KernelArgs&, size_t numPixels, size_t runs = 3);
+
+/**
+ * Engine which computes frames with given args in the least time. Engines which fail are skipped.
+ */
+ImageEnginePtr fastestEngine(const std::vector<ImageEnginePtr>&, const KernelArgs&, size_t numPixels);
+
+#endif //FRACTALEXPLORER_IMAGEENGINE_HPP
@@ -0,0 +1,162 @@
+#include "ImageIO.hpp"
+
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+LOGGER()
+
+/**
+ * Largest payload of a stored (uncompressed) deflate block.
+ */
+static constexpr size_t maxStoredBlockSize = 65535;
+
+static const std::array<uint32_t, 256>& crcTable() {
+    static const auto table = []() {
+        std::array<uint32_t, 256> t {};
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[n] = c;
+        }
+        return t;
+    }();
+    return table;
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size) {
+    const auto& table = crcTable();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void putBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static void writeChunk(std::ostream& out, const char type[4], const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> chunk;
+    chunk.reserve(data.size() + 12);
+    putBigEndian(chunk, static_cast<uint32_t>(data.size()));
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    // crc covers type and data, but not length
+    putBigEndian(chunk, crc32(0, chunk.data() + 4, chunk.size() - 4));
+    out.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+}
+
+void writePPM(std::ostream& out, const uint32_t* pixels, size_t width, size_t height) {
+    out << "P6\n" << width << " " << height << "\n255\n";
+    std::vector<uint8_t> row(width * 3);
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < width; ++x) {
+            std::memcpy(row.data() + x * 3, pixels + y * width + x, 3);
+        }
+        out.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+    }
+}
+
+void writePNG(std::ostream& out, const uint32_t* pixels, size_t width, size_t height) {
+    static constexpr uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+    std::vector<uint8_t> header;
+    putBigEndian(header, static_cast<uint32_t>(width));
+    putBigEndian(header, static_cast<uint32_t>(height));
+    // 8 bits per channel, RGBA, deflate, adaptive filtering, no interlace
+    header.insert(header.end(), { 8, 6, 0, 0, 0 });
+    writeChunk(out, "IHDR", header);
+
+    // scanlines with filter type 0 (none)
+    std::vector<uint8_t> raw;
+    raw.reserve(height * (width * 4 + 1));
+    for (size_t y = 0; y < height; ++y) {
+        raw.push_back(0);
+        auto* row = reinterpret_cast<const uint8_t*>(pixels + y * width);
+        raw.insert(raw.end(), row, row + width * 4);
+    }
+
+    // zlib stream of stored deflate blocks
+    std::vector<uint8_t> data;
+    data.reserve(raw.size() + raw.size() / maxStoredBlockSize * 5 + 16);
+    data.insert(data.end(), { 0x78, 0x01 });
+    size_t offset = 0;
+    do {
+        auto size = std::min(maxStoredBlockSize, raw.size() - offset);
+        bool last = offset + size == raw.size();
+        auto len = static_cast<uint16_t>(size);
+        auto nlen = static_cast<uint16_t>(~len);
+        data.insert(data.end(), {
+            static_cast<uint8_t>(last ? 1 : 0),
+            static_cast<uint8_t>(len), static_cast<uint8_t>(len >> 8),
+            static_cast<uint8_t>(nlen), static_cast<uint8_t>(nlen >> 8),
+        });
+        data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + size);
+        offset += size;
+    } while (offset < raw.size());
+
+    uint32_t a = 1, b = 0;
+    for (auto byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    putBigEndian(data, (b << 16) | a);
+    writeChunk(out, "IDAT", data);
+
+    writeChunk(out, "IEND", {});
+}
+
+void writeY4MHeader(std::ostream& out, size_t width, size_t height, size_t fps) {
+    out << "YUV4MPEG2 W" << width << " H" << height << " F" << fps << ":1 Ip A1:1 C444\n";
+}
+
+void writeY4MFrame(std::ostream& out, const uint32_t* pixels, size_t width, size_t height) {
+    auto numPixels = width * height;
+    std::vector<uint8_t> planes(numPixels * 3);
+    auto* yPlane = planes.data();
+    auto* uPlane = yPlane + numPixels;
+    auto* vPlane = uPlane + numPixels;
+    for (size_t i = 0; i < numPixels; ++i) {
+        auto* rgba = reinterpret_cast<const uint8_t*>(pixels + i);
+        int r = rgba[0], g = rgba[1], b = rgba[2];
+        yPlane[i] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        uPlane[i] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        vPlane[i] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+    out << "FRAME\n";
+    out.write(reinterpret_cast<const char*>(planes.data()), static_cast<std::streamsize>(planes.size()));
+}
+
+void writeImage(const std::filesystem::path& path, const uint32_t* pixels, size_t width, size_t height) {
+    auto extension = absl::AsciiStrToLower(path.extension().string());
+    if (extension != ".ppm" && extension != ".png") {
+        auto err = fmt::format("Unsupported image format '{}' of {}, expected .ppm or .png", extension, path.string());
+        logger->error(err);
+        throw std::invalid_argument(err);
+    }
+
+    std::ofstream out { path, std::ios::binary };
+    if (extension == ".ppm") {
+        writePPM(out, pixels, width, height);
+    } else {
+        writePNG(out, pixels, width, height);
+    }
+
+    if (!out) {
+        auto err = fmt::format("Failed to write image to {}", path.string());
+        logger->error(err);
+        throw std::runtime_error(err);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef FRACTALEXPLORER_IMAGEIO_HPP
+#define FRACTALEXPLORER_IMAGEIO_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+
+/**
+ * Write RGBA8 pixels (in memory order, rows top to bottom) as binary PPM. Alpha is dropped.
+ */
+void writePPM(std::ostream&, const uint32_t* pixels, size_t width, size_t height);
+
+/**
+ * Write RGBA8 pixels (in memory order, rows top to bottom) as PNG. Image data is stored without compression,
+ * which keeps writer dependency-free and fast; files can be recompressed offline if size matters.
+ */
+void writePNG(std::ostream&, const uint32_t* pixels, size_t width, size_t height);
+
+/**
+ * Write YUV4MPEG2 stream header for 4:4:4 frames of given size.
+ */
+void writeY4MHeader(std::ostream&, size_t width, size_t height, size_t fps);
+
+/**
+ * Write RGBA8 pixels as a frame of YUV4MPEG2 stream, converted to BT.601 limited range YCbCr.
+ */
+void writeY4MFrame(std::ostream&, const uint32_t* pixels, size_t width, size_t height);
+
+/**
+ * Write pixels in format chosen by file extension (.ppm or .png). Throws if format is unknown or file cannot be
+ * written.
+ */
+void writeImage(const std::filesystem::path&, const uint32_t* pixels, size_t width, size_t height);
+
+#endif //FRACTALEXPLORER_IMAGEIO_HPP
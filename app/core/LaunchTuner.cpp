@@ -0,0 +1,350 @@
+#include "LaunchTuner.hpp"
+
+#include "RenderStatistics.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+LOGGER()
+
+static constexpr size_t timedRuns = 3;
+
+/**
+ * Candidate has to be this much faster than the current best one, so that noise does not decide.
+ */
+static constexpr double minSpeedup = 1.03;
+
+/**
+ * Trajectories are chaotic, so builds of equal quality may still light different pixels. Images are compared
+ * by fraction of lit pixels in each tile instead.
+ */
+static constexpr size_t tileSize = 16;
+static constexpr double maxTileCoverageDifference = 0.05;
+
+static const std::vector<std::string> candidateOptions {
+    "-cl-mad-enable",
+    "-cl-no-signed-zeros",
+    "-cl-mad-enable -cl-no-signed-zeros",
+    "-cl-fast-relaxed-math",
+};
+
+/**
+ * Results file is shared by every kernel, so updates are serialized.
+ */
+static std::mutex resultsMutex;
+
+cl::NDRange LaunchConfiguration::localRange(size_t width, size_t height) const {
+    if (localWidth == 0 || localHeight == 0 || width % localWidth != 0 || height % localHeight != 0) {
+        return cl::NullRange;
+    }
+    return { localWidth, localHeight };
+}
+
+static double eventSeconds(const cl::Event& event) {
+    auto start = event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+    auto end = event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+    return (end - start) * 1e-9;
+}
+
+/**
+ * Identifies kernel (including its sources and options), image size and the device it runs on.
+ */
+static uint64_t tuningKey(
+    const KernelId& id, const KernelBase& base, const cl::Device& device, size_t width, size_t height
+) {
+    std::string key = fmt::format("{}x{}", width, height);
+    key.push_back('\0');
+    key.append(id.src);
+    key.push_back('\0');
+    key.append(id.settings);
+    key.push_back('\0');
+    for (const auto& [data, size] : base.sources()) {
+        key.append(data, size);
+        key.push_back('\0');
+    }
+    key.append(base.optionsString());
+    key.push_back('\0');
+    cl::Platform platform { device.getInfo<CL_DEVICE_PLATFORM>() };
+    key.append(platform.getInfo<CL_PLATFORM_NAME>());
+    key.append(device.getInfo<CL_DEVICE_NAME>());
+    key.append(device.getInfo<CL_DRIVER_VERSION>());
+    return contentHash(key);
+}
+
+/**
+ * Entries are lines of form "<key> <local width> <local height> [options]".
+ */
+static std::map<uint64_t, LaunchConfiguration> loadResults(const std::filesystem::path& file) {
+    std::map<uint64_t, LaunchConfiguration> results;
+    std::ifstream in { file };
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream entry { line };
+        uint64_t key;
+        LaunchConfiguration conf;
+        if (!(entry >> std::hex >> key >> std::dec >> conf.localWidth >> conf.localHeight)) {
+            continue;
+        }
+        std::getline(entry >> std::ws, conf.options);
+        results[key] = std::move(conf);
+    }
+    return results;
+}
+
+static void storeResults(const std::filesystem::path& file, const std::map<uint64_t, LaunchConfiguration>& results) {
+    std::error_code ec;
+    std::filesystem::create_directories(file.parent_path(), ec);
+
+    // other processes read this file concurrently, so it is replaced as a whole
+    auto tmpPath = file;
+    tmpPath += fmt::format(".{:x}.{:x}.tmp",
+        std::hash<std::thread::id> {} (std::this_thread::get_id()),
+        std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+        std::ofstream out { tmpPath, std::ios::trunc };
+        out << "# <key> <local width> <local height> [build options]\n";
+        for (const auto& [key, conf] : results) {
+            out << std::hex << key << std::dec << ' ' << conf.localWidth << ' ' << conf.localHeight << ' '
+                << conf.options << '\n';
+        }
+        if (!out) {
+            logger->warn(fmt::format("Failed to write launch configurations to {}", tmpPath.string()));
+            std::filesystem::remove(tmpPath, ec);
+            return;
+        }
+    }
+
+    std::filesystem::rename(tmpPath, file, ec);
+    if (ec) {
+        logger->warn(fmt::format("Failed to store launch configurations to {}: {}", file.string(), ec.message()));
+        std::filesystem::remove(tmpPath, ec);
+    }
+}
+
+/**
+ * Buffers which kernel writes besides the image. Contents of statistics are not used; density replaces the image
+ * of accumulating kernels when images are compared.
+ */
+struct TuningTarget {
+    cl::Image2D image;
+    cl::Buffer stats, hitMask, density;
+    size_t width, height;
+
+    /**
+     * Hit count of every pixel and maximum of them, as in OpenCLComputableImage.
+     */
+    size_t densityBytes() const {
+        return (width * height + 1) * sizeof(cl_uint);
+    }
+};
+
+static cl::Kernel bindKernel(
+    const cl::Program& program, const KernelId& id, const KernelArgs& args, const TuningTarget& target
+) {
+    cl::Kernel kernel { program, id.src.c_str() };
+    auto converted = convertArgs(detectArgumentTypesAndNames(kernel), args);
+    applyArgsToKernel(kernel, converted.begin(), converted.end());
+
+    auto names = mapNamesToArgIndices(kernel);
+    kernel.setArg(detectImageArgIdx(names), target.image);
+    auto dimensional = detectImageDimensionalArgIdxs(names);
+    for (size_t i = 0; i < dimensional.size() && i < 2; ++i) {
+        kernel.setArg(dimensional[i], i == 0 ? target.width : target.height);
+    }
+    if (auto arg = names.find("stats"); arg != names.end()) {
+        kernel.setArg(arg->second, target.stats);
+    }
+    if (auto arg = names.find("hit_mask"); arg != names.end()) {
+        kernel.setArg(arg->second, target.hitMask);
+    }
+    if (auto arg = names.find("density"); arg != names.end()) {
+        kernel.setArg(arg->second, target.density);
+    }
+    return kernel;
+}
+
+/**
+ * Median device time of a launch, after a warm-up launch.
+ */
+static double timeLaunch(
+    const cl::CommandQueue& queue, const cl::Kernel& kernel, const TuningTarget& target, const cl::NDRange& local
+) {
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, { target.width, target.height }, local);
+
+    std::vector<double> times;
+    for (size_t i = 0; i < timedRuns; ++i) {
+        cl::Event event;
+        queue.enqueueNDRangeKernel(kernel, cl::NullRange, { target.width, target.height }, local, nullptr, &event);
+        event.wait();
+        times.push_back(eventSeconds(event));
+    }
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    return times[times.size() / 2];
+}
+
+/**
+ * RGBA image drawn by kernel. Accumulating kernels do not draw; pixels they hit are drawn black instead.
+ */
+static std::vector<cl_uchar> render(
+    const cl::CommandQueue& queue, const cl::Kernel& kernel, const TuningTarget& target, const cl::NDRange& local
+) {
+    cl::size_t<3> origin, region;
+    region[0] = target.width;
+    region[1] = target.height;
+    region[2] = 1;
+    std::vector<cl_uchar> pixels(target.width * target.height * 4);
+
+    auto names = mapNamesToArgIndices(kernel);
+    if (names.find("density") == names.end()) {
+        queue.enqueueFillImage(target.image, cl_float4 { 1.0f, 1.0f, 1.0f, 1.0f }, origin, region);
+        queue.enqueueNDRangeKernel(kernel, cl::NullRange, { target.width, target.height }, local);
+        queue.enqueueReadImage(target.image, CL_TRUE, origin, region, 0, 0, pixels.data());
+        return pixels;
+    }
+
+    std::vector<cl_uint> density(target.width * target.height + 1);
+    queue.enqueueFillBuffer(target.density, cl_uint { 0 }, 0, target.densityBytes());
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, { target.width, target.height }, local);
+    queue.enqueueReadBuffer(target.density, CL_TRUE, 0, target.densityBytes(), density.data());
+    for (size_t i = 0; i < target.width * target.height; ++i) {
+        auto value = static_cast<cl_uchar>(density[i] > 0 ? 0 : 255);
+        pixels[4 * i] = pixels[4 * i + 1] = pixels[4 * i + 2] = value;
+        pixels[4 * i + 3] = 255;
+    }
+    return pixels;
+}
+
+/**
+ * Largest difference between fractions of lit (non-white) pixels in a tile of two RGBA images.
+ */
+static double coverageDifference(
+    const std::vector<cl_uchar>& a, const std::vector<cl_uchar>& b, size_t width, size_t height
+) {
+    auto lit = [](const std::vector<cl_uchar>& pixels, size_t idx) {
+        return pixels[4 * idx] != 255 || pixels[4 * idx + 1] != 255 || pixels[4 * idx + 2] != 255;
+    };
+
+    double result = 0;
+    for (size_t ty = 0; ty < height; ty += tileSize) {
+        for (size_t tx = 0; tx < width; tx += tileSize) {
+            long litA = 0, litB = 0, total = 0;
+            for (size_t y = ty; y < std::min(ty + tileSize, height); ++y) {
+                for (size_t x = tx; x < std::min(tx + tileSize, width); ++x) {
+                    litA += lit(a, y * width + x);
+                    litB += lit(b, y * width + x);
+                    ++total;
+                }
+            }
+            result = std::max(result, std::abs(litA - litB) / static_cast<double>(total));
+        }
+    }
+    return result;
+}
+
+static std::vector<std::pair<size_t, size_t>> candidateLocalSizes(
+    const cl::Kernel& kernel, const cl::Device& device, size_t width, size_t height
+) {
+    auto multiple = kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(device);
+    auto maxSize = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+    auto maxItemSizes = device.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>();
+
+    std::vector<std::pair<size_t, size_t>> result;
+    for (size_t total = std::max<size_t>(multiple, 1); total <= maxSize; total *= 2) {
+        for (size_t localHeight = 1; localHeight <= total; localHeight *= 2) {
+            auto localWidth = total / localHeight;
+            if (localWidth <= maxItemSizes[0] && localHeight <= maxItemSizes[1]
+                && width % localWidth == 0 && height % localHeight == 0) {
+                result.emplace_back(localWidth, localHeight);
+            }
+        }
+    }
+    return result;
+}
+
+LaunchConfiguration tuneLaunchConfiguration(
+    const KernelId& id, const KernelBase& base, const KernelArgs& args, size_t width, size_t height,
+    const cl::Context& ctx, const cl::CommandQueue& queue, ProgramBinaryCache& cache,
+    const std::filesystem::path& resultsFile, bool force
+) {
+    auto device = queue.getInfo<CL_QUEUE_DEVICE>();
+    auto key = tuningKey(id, base, device, width, height);
+    if (!force) {
+        std::lock_guard lock { resultsMutex };
+        auto results = loadResults(resultsFile);
+        if (auto found = results.find(key); found != results.end()) {
+            logger->info(fmt::format("Launch configuration of ({}, {}) loaded from {}",
+                id.src, id.settings, resultsFile.string()));
+            return found->second;
+        }
+    }
+
+    logger->info(fmt::format("Tuning launch configuration of ({}, {}) for {}x{} images on {}",
+        id.src, id.settings, width, height, device.getInfo<CL_DEVICE_NAME>()));
+
+    auto hitMaskSize = RenderStatistics::hitMaskWords(width * height) * sizeof(cl_uint);
+    TuningTarget target {
+        { ctx, CL_MEM_READ_WRITE, { CL_RGBA, CL_UNORM_INT8 }, width, height },
+        { ctx, CL_MEM_READ_WRITE, sizeof(RenderStatistics::DeviceCounters) },
+        { ctx, CL_MEM_READ_WRITE, hitMaskSize },
+        { ctx, CL_MEM_READ_WRITE, (width * height + 1) * sizeof(cl_uint) },
+        width, height
+    };
+    queue.enqueueFillBuffer(target.stats, cl_uint { 0 }, 0, sizeof(RenderStatistics::DeviceCounters));
+    queue.enqueueFillBuffer(target.hitMask, cl_uint { 0 }, 0, hitMaskSize);
+    queue.enqueueFillBuffer(target.density, cl_uint { 0 }, 0, target.densityBytes());
+
+    LaunchConfiguration result;
+    auto kernel = bindKernel(cache.build(base, ctx), id, args, target);
+
+    auto untunedTime = timeLaunch(queue, kernel, target, cl::NullRange);
+    auto bestTime = untunedTime;
+    for (auto [localWidth, localHeight] : candidateLocalSizes(kernel, device, width, height)) {
+        auto time = timeLaunch(queue, kernel, target, { localWidth, localHeight });
+        if (time * minSpeedup < bestTime) {
+            bestTime = time;
+            result.localWidth = localWidth;
+            result.localHeight = localHeight;
+        }
+    }
+
+    auto local = result.localRange(width, height);
+    auto reference = render(queue, kernel, target, local);
+    for (const auto& options : candidateOptions) {
+        try {
+            auto candidate = bindKernel(cache.build(base.withOptions(options), ctx), id, args, target);
+            auto difference = coverageDifference(reference, render(queue, candidate, target, local), width, height);
+            if (difference > maxTileCoverageDifference) {
+                logger->info(fmt::format("Options '{}' rejected: image differs by {:.3f}", options, difference));
+                continue;
+            }
+            auto time = timeLaunch(queue, candidate, target, local);
+            if (time * minSpeedup < bestTime) {
+                bestTime = time;
+                result.options = options;
+            }
+        } catch (const std::exception& e) {
+            logger->warn(fmt::format("Options '{}' cannot be tuned: {}", options, e.what()));
+        }
+    }
+
+    logger->info(fmt::format(
+        "Launch configuration of ({}, {}): local size {}x{}, options '{}'; {:.3f} ms per launch, untuned {:.3f} ms",
+        id.src, id.settings, result.localWidth, result.localHeight, result.options,
+        bestTime * 1e3, untunedTime * 1e3
+    ));
+
+    std::lock_guard lock { resultsMutex };
+    auto results = loadResults(resultsFile);
+    results[key] = result;
+    storeResults(resultsFile, results);
+    return result;
+}
@@ -0,0 +1,41 @@
+#ifndef FRACTALEXPLORER_LAUNCHTUNER_HPP
+#define FRACTALEXPLORER_LAUNCHTUNER_HPP
+
+#include "OpenCL.hpp"
+#include "OpenCLKernelUtils.hpp"
+#include "ProgramBinaryCache.hpp"
+
+#include <filesystem>
+
+/**
+ * How a kernel is launched: local work size and build options added to those of its base.
+ */
+struct LaunchConfiguration {
+    /**
+     * Zero means that local size is chosen by OpenCL implementation.
+     */
+    size_t localWidth = 0, localHeight = 0;
+
+    std::string options;
+
+    /**
+     * Local range for given global size. Tuned size is only used if it divides global size.
+     */
+    cl::NDRange localRange(size_t width, size_t height) const;
+};
+
+/**
+ * Benchmark launch configurations of a 2D image kernel on the device of given queue, using given args.
+ *
+ * Local sizes are built from CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE and must divide image size. Option sets
+ * (-cl-mad-enable, -cl-fast-relaxed-math etc.) are only accepted if the image they produce matches the one of
+ * untuned kernel. Results are persisted per (device, kernel, image size) in resultsFile and reused unless force
+ * is set.
+ */
+LaunchConfiguration tuneLaunchConfiguration(
+    const KernelId& id, const KernelBase& base, const KernelArgs& args, size_t width, size_t height,
+    const cl::Context& ctx, const cl::CommandQueue& queue, ProgramBinaryCache& cache,
+    const std::filesystem::path& resultsFile, bool force = false
+);
+
+#endif //FRACTALEXPLORER_LAUNCHTUNER_HPP
@@ -0,0 +1,153 @@
+#include "Metrics.hpp"
+
+#include "Utility.hpp"
+
+LOGGER()
+
+static size_t bucketIndex(uint64_t value) noexcept {
+    if (value < 16) {
+        return static_cast<size_t>(value);
+    }
+    size_t exponent = 63;
+    while (!(value >> exponent)) {
+        --exponent;
+    }
+    auto subBucket = (value >> (exponent - 2)) & 3;
+    return std::min(Histogram::numBuckets - 1, 16 + (exponent - 4) * 4 + static_cast<size_t>(subBucket));
+}
+
+static double bucketLowerBound(size_t index) noexcept {
+    if (index < 16) {
+        return static_cast<double>(index);
+    }
+    auto exponent = (index - 16) / 4 + 4;
+    auto subBucket = (index - 16) % 4;
+    return static_cast<double>((4 + subBucket) << (exponent - 2));
+}
+
+void Histogram::recordMicros(uint64_t micros) noexcept {
+    buckets_[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(micros, std::memory_order_relaxed);
+    auto max = max_.load(std::memory_order_relaxed);
+    while (micros > max && !max_.compare_exchange_weak(max, micros, std::memory_order_relaxed)) {}
+}
+
+Histogram::Summary Histogram::summary(bool reset) noexcept {
+    std::array<uint64_t, numBuckets> buckets;
+    uint64_t total = 0;
+    for (size_t i = 0; i < numBuckets; ++i) {
+        buckets[i] = reset ? buckets_[i].exchange(0, std::memory_order_relaxed)
+                           : buckets_[i].load(std::memory_order_relaxed);
+        total += buckets[i];
+    }
+    auto sum = reset ? sum_.exchange(0, std::memory_order_relaxed) : sum_.load(std::memory_order_relaxed);
+    auto max = reset ? max_.exchange(0, std::memory_order_relaxed) : max_.load(std::memory_order_relaxed);
+    if (reset) {
+        count_.exchange(0, std::memory_order_relaxed);
+    }
+
+    Summary summary;
+    summary.count = total;
+    if (total == 0) {
+        return summary;
+    }
+    // buckets are read one by one while being updated, so sum and counts can be slightly off; this is fine
+    summary.mean = sum * 1e-3 / total;
+    summary.max = max * 1e-3;
+
+    auto quantile = [&](double q) {
+        auto rank = static_cast<uint64_t>(q * (total - 1));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < numBuckets; ++i) {
+            seen += buckets[i];
+            if (seen > rank) {
+                return bucketLowerBound(i) * 1e-3;
+            }
+        }
+        return summary.max;
+    };
+    summary.p50 = quantile(0.50);
+    summary.p95 = quantile(0.95);
+    summary.p99 = quantile(0.99);
+    return summary;
+}
+
+Metrics& Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::~Metrics() {
+    stopReporting();
+}
+
+Counter& Metrics::counter(std::string_view name) {
+    std::lock_guard lock { mutex_ };
+    auto it = counters_.find(name);
+    if (it == counters_.end()) {
+        it = counters_.emplace(std::string { name }, std::make_unique<Counter>()).first;
+    }
+    return *it->second;
+}
+
+Histogram& Metrics::histogram(std::string_view name) {
+    std::lock_guard lock { mutex_ };
+    auto it = histograms_.find(name);
+    if (it == histograms_.end()) {
+        it = histograms_.emplace(std::string { name }, std::make_unique<Histogram>()).first;
+    }
+    return *it->second;
+}
+
+void Metrics::drain(std::chrono::duration<double> interval) {
+    std::string line;
+    {
+        std::lock_guard lock { mutex_ };
+        for (auto& [name, counter] : counters_) {
+            auto value = counter->exchange();
+            if (value != 0) {
+                line += fmt::format(" | {} {} ({:.1f}/s)", name, value, value / interval.count());
+            }
+        }
+        for (auto& [name, histogram] : histograms_) {
+            auto s = histogram->summary(true);
+            if (s.count != 0) {
+                line += fmt::format(
+                    " | {} n={} mean {:.2f} p50 {:.2f} p95 {:.2f} p99 {:.2f} max {:.2f} ms",
+                    name, s.count, s.mean, s.p50, s.p95, s.p99, s.max
+                );
+            }
+        }
+    }
+    if (!line.empty()) {
+        logger->info(fmt::format("Metrics{}", line));
+    }
+}
+
+void Metrics::startReporting(std::chrono::seconds interval) {
+    std::lock_guard lock { mutex_ };
+    if (reporter_.joinable()) {
+        return;
+    }
+    stopReporting_ = false;
+    reporter_ = std::thread([this, interval]() {
+        std::unique_lock lock { mutex_ };
+        while (!reporterWakeup_.wait_for(lock, interval, [this]() { return stopReporting_; })) {
+            lock.unlock();
+            drain(interval);
+            lock.lock();
+        }
+    });
+}
+
+void Metrics::stopReporting() {
+    {
+        std::lock_guard lock { mutex_ };
+        stopReporting_ = true;
+    }
+    reporterWakeup_.notify_all();
+    if (reporter_.joinable()) {
+        reporter_.join();
+    }
+}
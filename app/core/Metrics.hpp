@@ -0,0 +1,103 @@
+#ifndef FRACTALEXPLORER_METRICS_HPP
+#define FRACTALEXPLORER_METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * Monotonic event counter. Updating it is a single relaxed atomic add.
+ */
+class Counter {
+
+    std::atomic<uint64_t> value_ {0};
+
+public:
+
+    inline void add(uint64_t n = 1) noexcept { value_.fetch_add(n, std::memory_order_relaxed); }
+
+    inline uint64_t exchange(uint64_t value = 0) noexcept { return value_.exchange(value, std::memory_order_relaxed); }
+
+};
+
+/**
+ * Histogram of durations with logarithmic buckets (4 per power of two, so quantiles are accurate to ~25%).
+ * Recording is lock-free.
+ */
+class Histogram {
+
+public:
+
+    static constexpr size_t numBuckets = 256;
+
+    struct Summary {
+        uint64_t count = 0;
+        double mean = 0, p50 = 0, p95 = 0, p99 = 0, max = 0; // ms
+    };
+
+    void recordMicros(uint64_t micros) noexcept;
+
+    template <typename Rep, typename Period>
+    inline void record(std::chrono::duration<Rep, Period> duration) noexcept {
+        recordMicros(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count()));
+    }
+
+    /**
+     * Summary of samples recorded since last reset.
+     */
+    Summary summary(bool reset = false) noexcept;
+
+private:
+
+    std::array<std::atomic<uint64_t>, numBuckets> buckets_ {};
+    std::atomic<uint64_t> count_ {0}, sum_ {0}, max_ {0};
+
+};
+
+/**
+ * Registry of named counters and histograms for per-frame data. Looking metric up by name takes a lock, so
+ * hot paths should keep a reference:
+ *
+ *     static auto& frames = Metrics::instance().counter("frames");
+ *     frames.add();
+ *
+ * A background thread periodically drains all metrics into a single log line.
+ */
+class Metrics {
+
+    std::map<std::string, std::unique_ptr<Counter>, std::less<>> counters_;
+    std::map<std::string, std::unique_ptr<Histogram>, std::less<>> histograms_;
+    std::mutex mutex_;
+
+    std::thread reporter_;
+    std::condition_variable reporterWakeup_;
+    bool stopReporting_ = false;
+
+    void drain(std::chrono::duration<double> interval);
+
+public:
+
+    static Metrics& instance();
+
+    ~Metrics();
+
+    Counter& counter(std::string_view name);
+
+    Histogram& histogram(std::string_view name);
+
+    /**
+     * Start background thread logging metrics (and resetting them) every interval.
+     */
+    void startReporting(std::chrono::seconds interval);
+
+    void stopReporting();
+
+};
+
+#endif //FRACTALEXPLORER_METRICS_HPP
@@ -0,0 +1,78 @@
+#include "NativeNewtonFractal.hpp"
+
+#include "Tracer.hpp"
+#include "Utility.hpp"
+
+#include <mutex>
+
+LOGGER()
+
+/**
+ * Work-items computed together, lane per work-item.
+ */
+static constexpr size_t lanes = 4;
+
+/**
+ * Trajectories differ in length a lot, so tasks are small and stealing evens the load out.
+ */
+static constexpr size_t columnsPerTask = 4 * lanes;
+
+static void plot(std::atomic<uint32_t>* hitMask, size_t pixel) {
+    uint32_t bit = 1u << (pixel & 31);
+    auto& word = hitMask[pixel >> 5];
+    // plain read first: most hits land on pixels which are already marked
+    if (!(word.load(std::memory_order_relaxed) & bit)) {
+        word.fetch_or(bit, std::memory_order_relaxed);
+    }
+}
+
+NativeNewtonFractalEngine::NativeNewtonFractalEngine(size_t width, size_t height, size_t numThreads)
+    : pool_(numThreads)
+{
+    logger->info(fmt::format("Native engine uses {} threads, {} lanes per thread", pool_.size(), lanes));
+    resize(width, height);
+}
+
+void NativeNewtonFractalEngine::resize(size_t width, size_t height) {
+    if (width == width_ && height == height_) {
+        return;
+    }
+    width_ = width;
+    height_ = height;
+    hitMaskWords_ = RenderStatistics::hitMaskWords(width * height);
+    hitMask_ = std::make_unique<std::atomic<uint32_t>[]>(hitMaskWords_);
+    pixels_.assign(width * height, newtonFractalBackgroundPixel);
+    statistics_.reset();
+}
+
+void NativeNewtonFractalEngine::compute(const KernelArgs& args) {
+    TRACE_SCOPE("NativeNewtonFractalEngine::compute")
+    auto params = NewtonFractalParams::fromArgs(args);
+    for (size_t i = 0; i < hitMaskWords_; ++i) {
+        hitMask_[i].store(0, std::memory_order_relaxed);
+    }
+
+    // work-items of a column share seed (see init_state in CLC_Random.hpp), so device computes every column
+    // height times with identical results. Here each column is computed once, and counters are scaled instead.
+    std::mutex countersMutex;
+    NewtonFractalCounters counters;
+    pool_.parallelFor(width_, columnsPerTask, [&](size_t begin, size_t end) {
+        NewtonFractalCounters taskCounters;
+        for (size_t column = begin; column < end; column += lanes) {
+            NewtonFractalLanes<lanes>::compute(
+                params, column, width_, height_,
+                [this](size_t pixel) { plot(hitMask_.get(), pixel); },
+                taskCounters
+            );
+        }
+        std::lock_guard lock { countersMutex };
+        counters += taskCounters;
+    });
+
+    auto distinctPixels = composeNewtonFractalImage(hitMask_.get(), pixels_.size(), pixels_.data());
+    statistics_ = counters.statistics(height_, distinctPixels);
+}
+
+void NativeNewtonFractalEngine::read(uint32_t* pixels) {
+    std::memcpy(pixels, pixels_.data(), pixels_.size() * sizeof(uint32_t));
+}
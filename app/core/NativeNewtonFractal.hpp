@@ -0,0 +1,57 @@
+#ifndef FRACTALEXPLORER_NATIVENEWTONFRACTAL_HPP
+#define FRACTALEXPLORER_NATIVENEWTONFRACTAL_HPP
+
+#include "ImageEngine.hpp"
+#include "NewtonFractalHost.hpp"
+#include "WorkStealingPool.hpp"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * newton_fractal computed on CPU threads, for hosts without usable OpenCL platform. Solver, random number generator
+ * and plotting follow the OpenCL kernel, so images and statistics match those computed on device up to floating
+ * point differences.
+ */
+class NativeNewtonFractalEngine : public ImageEngine {
+
+    WorkStealingPool pool_;
+    size_t width_ = 0, height_ = 0;
+
+    /**
+     * Bit per pixel, like hit_mask of the kernel. Image is composed from it once all points are plotted.
+     */
+    std::unique_ptr<std::atomic<uint32_t>[]> hitMask_;
+    size_t hitMaskWords_ = 0;
+
+    std::vector<uint32_t> pixels_;
+    std::optional<RenderStatistics> statistics_;
+
+public:
+
+    explicit NativeNewtonFractalEngine(size_t width, size_t height,
+                                       size_t numThreads = std::thread::hardware_concurrency());
+
+    std::string name() const override { return "native"; }
+
+    bool ready() override { return true; }
+
+    ArgsTypesWithNames argTypes() override { return newtonFractalSignature(); }
+
+    void resize(size_t width, size_t height) override;
+
+    void compute(const KernelArgs&) override;
+
+    void read(uint32_t* pixels) override;
+
+    /**
+     * Image is computed in host memory, so it is handed out in place.
+     */
+    std::optional<MappedImage> map() override { return MappedImage { pixels_.data(), width_ }; }
+
+    std::optional<RenderStatistics> statistics() override { return statistics_; }
+
+};
+
+#endif //FRACTALEXPLORER_NATIVENEWTONFRACTAL_HPP
@@ -0,0 +1,81 @@
+#include "NewtonFractalHost.hpp"
+
+#include "Utility.hpp"
+
+LOGGER()
+
+const ArgsTypesWithNames& newtonFractalSignature() {
+    static const ArgsTypesWithNames signature {
+        { KernelArgType::Float64, "min_x" },
+        { KernelArgType::Float64, "max_x" },
+        { KernelArgType::Float64, "min_y" },
+        { KernelArgType::Float64, "max_y" },
+        { KernelArgType::Vector2Float64, "C" },
+        { KernelArgType::Int32, "backward" },
+        { KernelArgType::Int32, "t" },
+        { KernelArgType::Float64, "h" },
+        { KernelArgType::Int32, "runs_count" },
+        { KernelArgType::Int32, "points_count" },
+        { KernelArgType::Int32, "iter_skip" },
+        { KernelArgType::Int64, "seed" },
+        { KernelArgType::Vector3Float32, "color_in" },
+        { KernelArgType::Image, "image" },
+        { KernelArgType::Buffer, "stats" },
+        { KernelArgType::Buffer, "hit_mask" },
+    };
+    return signature;
+}
+
+/**
+ * Component of argument at given index of signature.
+ */
+template <typename T>
+static T argComponent(const KernelArgs& args, size_t idx, size_t component = 0) {
+    const auto& name = newtonFractalSignature()[idx].second;
+    auto arg = args.find(name);
+    if (arg == args.end()) {
+        arg = args.find(idx);
+    }
+    if (arg == args.end()) {
+        auto err = fmt::format("Argument \"{}\" of newton_fractal is missing", name);
+        logger->error(err);
+        throw std::invalid_argument(err);
+    }
+    return std::visit([](auto v) { return static_cast<T>(v); }, getVectorComponent(component, arg->second.value));
+}
+
+NewtonFractalParams NewtonFractalParams::fromArgs(const KernelArgs& args) {
+    NewtonFractalParams p {};
+    p.minX = argComponent<double>(args, 0);
+    p.maxX = argComponent<double>(args, 1);
+    p.minY = argComponent<double>(args, 2);
+    p.maxY = argComponent<double>(args, 3);
+    p.cx = argComponent<double>(args, 4, 0);
+    p.cy = argComponent<double>(args, 4, 1);
+    p.backward = argComponent<cl_int>(args, 5);
+    p.t = argComponent<cl_int>(args, 6);
+    p.h = argComponent<double>(args, 7);
+    p.runsCount = argComponent<cl_uint>(args, 8);
+    p.pointsCount = argComponent<cl_uint>(args, 9);
+    p.iterSkip = argComponent<cl_uint>(args, 10);
+    p.seed = argComponent<cl_ulong>(args, 11);
+    return p;
+}
+
+NewtonFractalCounters& NewtonFractalCounters::operator+=(const NewtonFractalCounters& other) {
+    pointsGenerated += other.pointsGenerated;
+    pointsInViewport += other.pointsInViewport;
+    frozenTrajectories += other.frozenTrajectories;
+    solverFailures += other.solverFailures;
+    return *this;
+}
+
+RenderStatistics NewtonFractalCounters::statistics(size_t rows, uint32_t distinctPixels) const {
+    RenderStatistics stats;
+    stats.pointsGenerated = pointsGenerated * rows;
+    stats.pointsInViewport = pointsInViewport * rows;
+    stats.frozenTrajectories = static_cast<uint32_t>(frozenTrajectories * rows);
+    stats.solverFailures = static_cast<uint32_t>(solverFailures * rows);
+    stats.distinctPixels = distinctPixels;
+    return stats;
+}
@@ -0,0 +1,310 @@
+#ifndef FRACTALEXPLORER_NEWTONFRACTALHOST_HPP
+#define FRACTALEXPLORER_NEWTONFRACTALHOST_HPP
+
+#include "OpenCLKernelUtils.hpp"
+#include "RenderStatistics.hpp"
+#include "SimdPack.hpp"
+
+#include <bitset>
+#include <cstring>
+
+/**
+ * Arguments of newton_fractal, see CLC_NewtonFractal.hpp.
+ */
+struct NewtonFractalParams {
+    double minX, maxX, minY, maxY;
+    double cx, cy;
+    cl_int backward, t;
+    double h;
+    cl_uint runsCount, pointsCount, iterSkip;
+    cl_ulong seed;
+
+    /**
+     * Read params from args keyed by names or indices of newtonFractalSignature().
+     */
+    static NewtonFractalParams fromArgs(const KernelArgs&);
+};
+
+/**
+ * Signature of newton_fractal kernel, as detected by OpenCL on devices with fp64 support.
+ */
+const ArgsTypesWithNames& newtonFractalSignature();
+
+/**
+ * Counters of RenderStatistics accumulated by a subset of work-items.
+ */
+struct NewtonFractalCounters {
+    uint64_t pointsGenerated = 0;
+    uint64_t pointsInViewport = 0;
+    uint64_t frozenTrajectories = 0;
+    uint64_t solverFailures = 0;
+
+    NewtonFractalCounters& operator+=(const NewtonFractalCounters&);
+
+    /**
+     * Statistics of the whole image, with counters of every column repeated for given number of rows.
+     */
+    RenderStatistics statistics(size_t rows, uint32_t distinctPixels) const;
+};
+
+// RGBA8 pixels in memory order, as read from CL_RGBA / CL_UNORM_INT8 image on little-endian hosts
+static constexpr uint32_t newtonFractalBackgroundPixel = 0xFFFFFFFFu;
+static constexpr uint32_t newtonFractalPointPixel = 0xFF000000u;
+
+/**
+ * Compose image from hit mask (bit per pixel). Returns number of lit pixels.
+ */
+template <typename Word>
+uint32_t composeNewtonFractalImage(const Word* hitMask, size_t numPixels, uint32_t* pixels) {
+    uint32_t lit = 0;
+    for (size_t i = 0; i < RenderStatistics::hitMaskWords(numPixels); ++i) {
+        lit += static_cast<uint32_t>(std::bitset<32>(static_cast<uint32_t>(hitMask[i])).count());
+    }
+    for (size_t i = 0; i < numPixels; ++i) {
+        bool hit = static_cast<uint32_t>(hitMask[i >> 5]) & (1u << (i & 31));
+        pixels[i] = hit ? newtonFractalPointPixel : newtonFractalBackgroundPixel;
+    }
+    return lit;
+}
+
+/**
+ * newton_fractal of CLC_NewtonFractal.hpp ported to host, N work-items of a row at a time (lane per work-item).
+ * Scalar port which runs lanes in lockstep: solver's cbrt, atan2, sin, cos and hypot are evaluated lane by lane.
+ * CPU engines share it and only differ in how packs of columns are scheduled.
+ */
+template <size_t N>
+struct NewtonFractalLanes {
+
+    using Real = Pack<double, N>;
+    using Uint = Pack<uint32_t, N>;
+    using Int = Pack<int32_t, N>;
+    using Lanes = Mask<N>;
+
+    // same as in CLC_Definitions.hpp for double precision
+    static constexpr double pi = 3.14159265358979323846;
+    static constexpr double complOne2ndRootReal = -0.5;
+    static constexpr double complOne2ndRootImag = 0.866025403784438596;
+    static constexpr double complOne3rdRootReal = complOne2ndRootReal;
+    static constexpr double complOne3rdRootImag = -complOne2ndRootImag;
+
+    static constexpr uint64_t mwc64xMultiplier = 4294883355u;
+    static constexpr double solverPrecision = 1e-8;
+    static constexpr int32_t maxFrozenSteps = 15;
+
+    struct Complex {
+        Real x, y;
+    };
+
+    /**
+     * MWC64X generators of a pack of work-items, seeded as init_state in CLC_Random.hpp does.
+     */
+    struct Random {
+        Uint x, c;
+
+        Random(uint32_t firstWorkItem, cl_ulong seed) {
+            auto sx = static_cast<uint32_t>(seed);
+            auto sy = static_cast<uint32_t>(seed >> 32);
+            for (size_t i = 0; i < N; ++i) {
+                uint32_t id = firstWorkItem + static_cast<uint32_t>(i) + 1;
+                x[i] = ((id + sx) & 0xFFFFu) * sy;
+                c[i] = (id ^ (sy & 0xFFFF0000u)) ^ sx;
+            }
+        }
+
+        /**
+         * Next values of generators. Generators of inactive lanes are left as is.
+         */
+        Uint next(const Lanes& active) {
+            Uint result = x ^ c;
+            auto product = map([](uint32_t v) { return static_cast<uint64_t>(v) * mwc64xMultiplier; }, x);
+            Uint hi = map([](uint64_t v) { return static_cast<uint32_t>(v >> 32); }, product);
+            Uint nextX = map([](uint64_t v) { return static_cast<uint32_t>(v); }, product) + c;
+            Uint nextC = hi + (nextX < c).template cast<uint32_t>();
+            x = select(active, nextX, x);
+            c = select(active, nextC, c);
+            return result;
+        }
+
+        /**
+         * Uniform values in [0; 1].
+         */
+        Real real(const Lanes& active) {
+            return next(active).template cast<double>() / static_cast<double>(0xffffffffu);
+        }
+    };
+
+    /**
+     * to_uint of CLC_NewtonFractal.hpp: lower 32 bits of representation of a double.
+     */
+    static Uint lowBits(const Real& r) {
+        return map([](double v) {
+            uint64_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            return static_cast<uint32_t>(bits);
+        }, r);
+    }
+
+    static Real length(const Real& x, const Real& y) {
+        return map([](double x, double y) { return std::hypot(x, y); }, x, y);
+    }
+
+    static void complexCbrt(const Complex& a, Complex roots[3]) {
+        Real cbrtAbs = cbrt(length(a.x, a.y));
+        Real phi = atan2(a.y, a.x) / 3.0;
+        for (int k = 0; k < 3; ++k) {
+            Real angle = phi + 2 * k * pi / 3.0;
+            roots[k] = { cos(angle) * cbrtAbs, sin(angle) * cbrtAbs };
+        }
+    }
+
+    /**
+     * solve_cubic_newton_fractal_optimized of CLC_NewtonFractal.hpp, for every lane. Returns lanes which have root.
+     */
+    static Lanes solveCubic(const Complex& a, double cx, double cy, const Uint& root, Complex& result) {
+        Real ax = a.x, ay = a.y;
+        Real ax2 = ax * ax, ay2 = ay * ay;
+
+        Complex d {
+            (cx*cx - cy*cy) / 4.0 + (cx*ax*(ax2 - 3.0*ay2) - cy*ay*(3.0*ax2 - ay2)) / 27.0,
+            cx*cy / 2.0 + (cx*ay*(3.0*ax2 - ay2) + cy*ax*(ax2 - 3.0*ay2)) / 27.0
+        };
+        Real modulus = length(d.x, d.y);
+        Complex firstRootOfD {
+            sqrt((modulus + d.x) / 2.0),
+            sign(d.y) * sqrt((modulus - d.x) / 2.0)
+        };
+
+        Complex baseAlpha {
+            ax * (3.0*ay2 - ax2) / 27.0 - cx / 2.0,
+            ay * (ay2 - 3.0*ax2) / 27.0 - cy / 2.0
+        };
+        Complex baseBeta { baseAlpha.x + firstRootOfD.x, baseAlpha.y + firstRootOfD.y };
+        baseAlpha = { baseAlpha.x - firstRootOfD.x, baseAlpha.y - firstRootOfD.y };
+
+        Complex alpha[3], beta[3];
+        complexCbrt(baseAlpha, alpha);
+        complexCbrt(baseBeta, beta);
+
+        // beta which pairs with alpha[0], such that alpha[0]*beta = -p/3
+        Lanes found = false;
+        Complex b { 0.0, 0.0 };
+        for (int i = 0; i < 3; ++i) {
+            Real rx = alpha[0].x * beta[i].x - alpha[0].y * beta[i].y + (ay2 - ax2) / 9.0;
+            Real ry = alpha[0].y * beta[i].x + alpha[0].x * beta[i].y - 2.0*ax*ay / 9.0;
+            Lanes matches = !found && abs(rx) < solverPrecision && abs(ry) < solverPrecision;
+            b = { select(matches, beta[i].x, b.x), select(matches, beta[i].y, b.y) };
+            found = found || matches;
+        }
+
+        Real ax3 = ax / 3.0, ay3 = ay / 3.0;
+        Complex roots[3] {
+            // alpha_1 + beta_1 - a/3
+            { alpha[0].x + b.x - ax3, alpha[0].y + b.y - ay3 },
+            // alpha_2 + beta_3 - a/3
+            {
+                alpha[1].x - ax3 + complOne3rdRootReal*b.x - complOne3rdRootImag*b.y,
+                alpha[1].y - ay3 + complOne3rdRootReal*b.y + complOne3rdRootImag*b.x
+            },
+            // alpha_3 + beta_2 - a/3
+            {
+                alpha[2].x - ax3 + complOne2ndRootReal*b.x - complOne2ndRootImag*b.y,
+                alpha[2].y - ay3 + complOne2ndRootReal*b.y + complOne2ndRootImag*b.x
+            },
+        };
+        Lanes isFirst = root == 1u, isSecond = root == 2u;
+        result = {
+            select(isSecond, roots[2].x, select(isFirst, roots[1].x, roots[0].x)),
+            select(isSecond, roots[2].y, select(isFirst, roots[1].y, roots[0].y)),
+        };
+        return found;
+    }
+
+    /**
+     * Forward step of newton_fractal: a - h/3 * a - h/3 * C / a^2.
+     */
+    static Complex forwardStep(const Complex& a, double cx, double cy, double h) {
+        Real denominator = a.x*a.x*a.x*a.x + a.y*a.y*a.y*a.y + 2.0*a.x*a.x*a.y*a.y;
+        Complex last { (a.x*a.x - a.y*a.y) / denominator, -2.0*a.x*a.y / denominator };
+        Complex lastMulC { last.x*cx - last.y*cy, last.x*cy + last.y*cx };
+        return {
+            a.x - h / 3.0 * a.x - h * lastMulC.x / 3.0,
+            a.y - h / 3.0 * a.y - h * lastMulC.y / 3.0
+        };
+    }
+
+    /**
+     * Body of newton_fractal for work-items [firstColumn; firstColumn + N) of a row. Lanes past width are idle.
+     * plot(pixel) is called for every point which lands in viewport, pixel being index in row-major image.
+     */
+    template <typename Plot>
+    static void compute(
+        const NewtonFractalParams& p, size_t firstColumn, size_t width, size_t height,
+        Plot&& plot, NewtonFractalCounters& counters
+    ) {
+        Lanes valid = Lanes::generate([&](size_t i) { return firstColumn + i < width; });
+        Random rng { static_cast<uint32_t>(firstColumn), p.seed };
+
+        double spanX = p.maxX - p.minX;
+        double spanY = p.maxY - p.minY;
+        double scaleX = spanX / width;
+        double scaleY = spanY / height;
+        // t sign switches between Explicit and Implicit Euler method
+        double cx = -p.cx * p.h * p.t / (3 - p.t * p.h);
+        double cy = -p.cy * p.h * p.t / (3 - p.t * p.h);
+        double aModifier = -3 / (3 - p.t * p.h);
+
+        for (cl_uint run = 0; run < p.runsCount; ++run) {
+            Real randomX = rng.real(valid);
+            Real randomY = rng.real(valid);
+            Complex point { (randomX * spanX + p.minX) / 2.0, (randomY * spanY + p.minY) / 2.0 };
+            Lanes alive = valid;
+            Int frozen = 0;
+
+            for (cl_uint i = 0; i < p.pointsCount && any(alive); ++i) {
+                Uint rootNumber = (lowBits(rng.real(alive)) >> 7u) % 3u;
+                if (p.backward) {
+                    Complex a { point.x * aModifier, point.y * aModifier };
+                    Complex root;
+                    Lanes solved = solveCubic(a, cx, cy, rootNumber, root);
+                    // root is undefined, trajectory cannot be continued
+                    counters.solverFailures += count(alive && !solved);
+                    alive = alive && solved;
+                    point = { select(alive, root.x, point.x), select(alive, root.y, point.y) };
+                } else {
+                    Complex next = forwardStep(point, p.cx, p.cy, p.h);
+                    point = { select(alive, next.x, point.x), select(alive, next.y, point.y) };
+                }
+                counters.pointsGenerated += count(alive);
+
+                // the first iter_skip points are skipped
+                if (i < p.iterSkip) {
+                    continue;
+                }
+
+                // device truncates coordinates towards zero, so (-1; 0) still lands on the first pixel
+                Real x = (point.x - p.minX) / scaleX;
+                Real y = (point.y - p.minY) / scaleY;
+                Lanes inView = alive && x > -1.0 && x < static_cast<double>(width)
+                    && y > -1.0 && y < static_cast<double>(height);
+                for (size_t lane = 0; lane < N; ++lane) {
+                    if (inView[lane]) {
+                        auto px = static_cast<size_t>(static_cast<int32_t>(x[lane]));
+                        auto py = height - 1 - static_cast<size_t>(static_cast<int32_t>(y[lane]));
+                        plot(py * width + px);
+                    }
+                }
+                counters.pointsInViewport += count(inView);
+
+                Lanes outOfView = alive && !inView;
+                frozen = select(inView, Int(0), frozen + outOfView.template cast<int32_t>());
+                // this generally means that solution is going to approach infinity
+                Lanes frozenNow = outOfView && frozen > maxFrozenSteps;
+                counters.frozenTrajectories += count(frozenNow);
+                alive = alive && !frozenNow;
+            }
+        }
+    }
+
+};
+
+#endif //FRACTALEXPLORER_NEWTONFRACTALHOST_HPP
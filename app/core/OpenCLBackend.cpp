@@ -1,36 +1,368 @@
 #include "OpenCLBackend.hpp"
+#include "CoExecution.hpp"
 #include "Utility.hpp"
 #include "OpenCLKernelUtils.hpp"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 
 #include "Utility.hpp"
 
 LOGGER()
 
-OpenCLBackend::OpenCLBackend() {
-    ctx = cl::Context::getDefault();
-    queue = cl::CommandQueue::getDefault();
+static std::atomic<uint64_t> backendInstanceCounter {0};
+
+OpenCLBackend::OpenCLBackend()
+    : OpenCLBackend(cl::Context::getDefault(), cl::CommandQueue {})
+{
+    queue = cl::CommandQueue { ctx, ctx.getInfo<CL_CONTEXT_DEVICES>().front(), CL_QUEUE_PROFILING_ENABLE };
+    batchQueue_ = queue;
+}
+
+OpenCLBackend::OpenCLBackend(const cl::Device& device)
+    : OpenCLBackend(cl::Context { device }, cl::CommandQueue {})
+{
+    queue = cl::CommandQueue { ctx, device, CL_QUEUE_PROFILING_ENABLE };
+    batchQueue_ = queue;
+}
+
+OpenCLBackend::OpenCLBackend(cl::Context context, cl::CommandQueue commandQueue)
+    : ctx(std::move(context)),
+      queue(std::move(commandQueue)),
+      batchQueue_(queue),
+      instanceId_(backendInstanceCounter++),
+      liveness_(std::make_shared<Liveness>()),
+      binaryCache_(cacheDirectory() / "programs"),
+      compilePool_(std::max(std::thread::hardware_concurrency() / 2, 1u)),
+      memoryBudget_(std::make_shared<DeviceMemoryBudget>(DeviceMemoryBudget::defaultLimit(ctx))),
+      memoryPool_(std::make_shared<DeviceMemoryPool>(memoryBudget_))
+{
+    liveness_->backend = this;
+    logger->info(fmt::format("Device memory budget: {}", to_string(memoryBudget_->usage())));
+}
+
+OpenCLBackend::~OpenCLBackend() {
+    {
+        std::lock_guard lock { liveness_->mutex };
+        liveness_->backend = nullptr;
+    }
+    // budget may outlive backend (pooled images keep it), so eviction callbacks must not reference it anymore
+    for (const auto& [key, entry] : programEntries_) {
+        if (entry.reclaimable) {
+            memoryBudget_->removeReclaimable(*entry.reclaimable);
+        }
+        memoryBudget_->free(DeviceMemoryOwner::Program, entry.bytes);
+    }
+}
+
+cl::Kernel OpenCLBackend::compileCLKernel(KernelId id, const cl::Context& context, const std::string& options) {
+    return cloneKernel({ id, context, options }, [&]() {
+        return compileProgramAsync(id, context, options).get();
+    });
 }
 
-cl::Kernel OpenCLBackend::compileCLKernel(KernelId id) {
-    auto foundInCache = this->compileCache_.find(CompilationContext { id, ctx });
+cl::Kernel OpenCLBackend::cloneKernel(const CompilationContext& key, const std::function<cl::Program()>& program) {
+    struct Clone {
+        cl::Kernel kernel;
+        std::shared_ptr<void> programLease;
+        std::chrono::steady_clock::time_point lastUsed;
+    };
+    struct ThreadKernels {
+        std::weak_ptr<void> backendAlive;
+        uint64_t generation = 0;
+        std::unordered_map<CompilationContext, Clone> kernels;
+    };
+    // kernel clones owned by the calling thread, per backend instance
+    thread_local std::unordered_map<uint64_t, ThreadKernels> threadKernels;
+
+    // clones keep their programs alive, so those of destroyed backends and unused ones are dropped
+    auto& local = threadKernels[instanceId_];
+    local.backendAlive = liveness_;
+    for (auto it = threadKernels.begin(); it != threadKernels.end();) {
+        it = it->second.backendAlive.expired() ? threadKernels.erase(it) : std::next(it);
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    auto generation = cacheGeneration_.load();
+    if (local.generation != generation) {
+        local.generation = generation;
+        local.kernels.clear();
+    }
+    for (auto it = local.kernels.begin(); it != local.kernels.end();) {
+        bool idle = now - it->second.lastUsed > kernelCloneIdleTime;
+        it = idle ? local.kernels.erase(it) : std::next(it);
+    }
+
+    auto foundClone = local.kernels.find(key);
+    if (foundClone != local.kernels.end()) {
+        foundClone->second.lastUsed = now;
+        return foundClone->second.kernel;
+    }
+
+    // program is built (or waited for) first, so that it is accounted by the time lease is acquired
+    cl::Kernel kernel { program(), key.id.src.c_str() };
+    return local.kernels.try_emplace(key, Clone { kernel, acquireProgram(key), now }).first->second.kernel;
+}
+
+std::string OpenCLBackend::specializedOptions(
+    const KernelId& id, const KernelArgs& args, const cl::Context& context, const std::string& extraOptions
+) {
+    auto options = findKernelBase(id).specializationOptions(args, mapNamesToArgIndices(compileCLKernel(id, context)));
+    if (!extraOptions.empty()) {
+        options = options.empty() ? extraOptions : extraOptions + " " + options;
+    }
+    return options;
+}
+
+cl::Kernel OpenCLBackend::selectSpecializedKernel(
+    KernelId id, const KernelArgs& args, const cl::Context& context, const std::string& extraOptions
+) {
+    auto generic = compileCLKernel(id, context);
+    auto options = specializedOptions(id, args, context, extraOptions);
+    if (options.empty()) {
+        return generic;
+    }
+
+    CompilationContext key { id, context, options };
+    std::shared_future<cl::Program> program;
+    {
+        std::shared_lock lock { compileCacheMutex_ };
+        auto found = specializations_.find(key);
+        if (found != specializations_.end()) {
+            if (found->second.failed) {
+                return generic;
+            }
+            program = found->second.program;
+        }
+    }
+
+    if (!program.valid()) {
+        auto compiling = compileProgramAsync(id, context, options);
+        std::unique_lock lock { compileCacheMutex_ };
+        program = specializations_.try_emplace(key, Specialization { compiling }).first->second.program;
+        LOG_DEBUG("Kernel ({}, {}) is being specialized with {}", id.src, id.settings, options);
+    }
+
+    if (program.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return generic;
+    }
+
+    try {
+        auto kernel = cloneKernel(key, [&]() { return program.get(); });
+        std::unique_lock lock { compileCacheMutex_ };
+        if (auto found = specializations_.find(key); found != specializations_.end() && !found->second.active) {
+            found->second.active = true;
+            logger->info(fmt::format("Kernel ({}, {}) switched to variant {}", id.src, id.settings, options));
+        }
+        return kernel;
+    } catch (const std::exception& e) {
+        logger->warn(fmt::format(
+            "Kernel ({}, {}) cannot be specialized with {}, using generic variant: {}",
+            id.src, id.settings, options, e.what()
+        ));
+        std::unique_lock lock { compileCacheMutex_ };
+        specializations_[key].failed = true;
+        return generic;
+    }
+}
+
+std::shared_future<cl::Program> OpenCLBackend::compileProgramAsync(KernelId id) {
+    return compileProgramAsync(std::move(id), ctx);
+}
+
+std::shared_future<cl::Program> OpenCLBackend::compileProgramAsync(
+    KernelId id, const cl::Context& context, const std::string& options
+) {
+    CompilationContext key { id, context, options };
+
+    {
+        std::shared_lock lock { compileCacheMutex_ };
+        auto foundInCache = this->compileCache_.find(key);
+        if (foundInCache != compileCache_.end()) {
+            if (auto entry = programEntries_.find(key); entry != programEntries_.end() && entry->second.reclaimable) {
+                memoryBudget_->touch(*entry->second.reclaimable);
+            }
+            return foundInCache->second;
+        }
+    }
+
+    // build a program from base. base is copied so that registry can be safely updated meanwhile
+    auto base = findKernelBase(id).withOptions(options);
+
+    std::unique_lock lock { compileCacheMutex_ };
+    // somebody could have started compilation while exclusive lock was being acquired
+    auto foundInCache = this->compileCache_.find(key);
     if (foundInCache != compileCache_.end()) {
         logger->info(
-            fmt::format("Kernel ({}, {}) was found in cache!", id.src, id.settings)
+            fmt::format("Kernel ({}, {}) [{}] was found in cache!", id.src, id.settings, options)
                     );
         return foundInCache->second;
     }
 
-    logger->info(fmt::format("Kernel ({}, {}) not in cache, compiling...", id.src, id.settings));
+    logger->info(fmt::format("Kernel ({}, {}) [{}] not in cache, compiling...", id.src, id.settings, options));
+
+    auto compiled = compilePool_.submit([this, key, base = std::move(base)]() {
+        try {
+            auto program = binaryCache_.build(base, key.ctx);
+            accountProgram(key, program);
+            return program;
+        } catch (...) {
+            // failed compilations should not stick in cache
+            std::unique_lock lock { compileCacheMutex_ };
+            compileCache_.erase(key);
+            throw;
+        }
+    }).share();
+
+    compileCache_.try_emplace(key, compiled);
+    return compiled;
+}
+
+void OpenCLBackend::accountProgram(const CompilationContext& key, const cl::Program& program) {
+    // programs for other contexts (e.g. of co-execution devices) do not take memory of this device
+    if (key.ctx() != ctx()) {
+        return;
+    }
+
+    // device-side size of a program is not exposed by OpenCL; size of its binaries is a reasonable estimate
+    size_t bytes = 0;
+    for (auto size : program.getInfo<CL_PROGRAM_BINARY_SIZES>()) {
+        bytes += size;
+    }
+    // may evict other programs, which takes compileCacheMutex_
+    memoryBudget_->account(DeviceMemoryOwner::Program, bytes);
+
+    // registered under the same lock as entry, so that eviction cannot run in between and miss it
+    std::unique_lock lock { compileCacheMutex_ };
+    auto [entry, inserted] = programEntries_.try_emplace(key);
+    if (!inserted) {
+        memoryBudget_->free(DeviceMemoryOwner::Program, bytes);
+        return;
+    }
+    entry->second.bytes = bytes;
+    // program has no kernel clones until it is returned from compilation
+    entry->second.reclaimable = makeProgramReclaimable(key, bytes);
+}
+
+DeviceMemoryBudget::EntryHandle OpenCLBackend::makeProgramReclaimable(const CompilationContext& key, size_t bytes) {
+    return memoryBudget_->addReclaimable(DeviceMemoryOwner::Program, bytes, [this, key]() {
+        std::unique_lock lock { compileCacheMutex_ };
+        auto entry = programEntries_.find(key);
+        // kernel could have been cloned after entry was picked for eviction
+        if (entry == programEntries_.end() || entry->second.kernels > 0) {
+            return false;
+        }
+        if (entry->second.reclaimable) {
+            memoryBudget_->removeReclaimable(*entry->second.reclaimable);
+        }
+        programEntries_.erase(entry);
+        compileCache_.erase(key);
+        // specialized variant is compiled again on next request, generic one is used meanwhile
+        specializations_.erase(key);
+        logger->info(fmt::format(
+            "Program ({}, {}) [{}] evicted from cache", key.id.src, key.id.settings, key.options
+        ));
+        return true;
+    });
+}
+
+std::shared_ptr<void> OpenCLBackend::acquireProgram(const CompilationContext& key) {
+    {
+        std::unique_lock lock { compileCacheMutex_ };
+        auto entry = programEntries_.find(key);
+        if (entry == programEntries_.end()) {
+            return {};
+        }
+        if (entry->second.kernels++ == 0 && entry->second.reclaimable) {
+            memoryBudget_->removeReclaimable(*entry->second.reclaimable);
+            entry->second.reclaimable.reset();
+        }
+    }
+
+    // released by threads dropping their clones, possibly after backend is gone
+    return std::shared_ptr<void>(nullptr, [liveness = std::weak_ptr<Liveness>(liveness_), key](void*) {
+        if (auto alive = liveness.lock()) {
+            std::lock_guard lock { alive->mutex };
+            if (alive->backend != nullptr) {
+                alive->backend->releaseProgram(key);
+            }
+        }
+    });
+}
 
-    // build a kernel from base
-    return this->compileCache_.try_emplace(
-        CompilationContext {id, ctx}, findKernelBase(id).build(ctx), id.src.c_str()
-    ).first->second;
+void OpenCLBackend::releaseProgram(const CompilationContext& key) {
+    std::unique_lock lock { compileCacheMutex_ };
+    auto entry = programEntries_.find(key);
+    // entry may have been cleared and compiled again meanwhile
+    if (entry == programEntries_.end() || entry->second.kernels == 0) {
+        return;
+    }
+    if (--entry->second.kernels == 0) {
+        entry->second.reclaimable = makeProgramReclaimable(key, entry->second.bytes);
+    }
+}
+
+LaunchConfiguration OpenCLBackend::launchConfiguration(
+    const KernelId& id, const KernelArgs& args, size_t width, size_t height, bool wait
+) {
+    const auto& base = findKernelBase(id);
+    LaunchConfigurationKey key {
+        id, width, height, base.specializationOptions(args, mapNamesToArgIndices(compileCLKernel(id, ctx)))
+    };
+
+    std::shared_future<LaunchConfiguration> tuned;
+    {
+        std::lock_guard lock { launchConfigurationsMutex_ };
+        auto found = launchConfigurations_.find(key);
+        if (found == launchConfigurations_.end()) {
+            auto task = [this, key, base = base.withOptions(key.options), args, context = ctx, queue = queue]() {
+                try {
+                    return tuneLaunchConfiguration(
+                        key.id, base, args, key.width, key.height, context, queue, binaryCache_,
+                        cacheDirectory() / "launch-tuning.txt"
+                    );
+                } catch (const std::exception& e) {
+                    logger->warn(fmt::format(
+                        "Failed to tune launch configuration of ({}, {}) [{}]: {}",
+                        key.id.src, key.id.settings, key.options, e.what()
+                    ));
+                    return LaunchConfiguration {};
+                }
+            };
+            found = launchConfigurations_.try_emplace(key, tuningPool_.submit(std::move(task)).share()).first;
+        }
+        tuned = found->second;
+    }
+
+    if (!wait && tuned.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return {};
+    }
+    return tuned.get();
+}
+
+std::vector<std::shared_future<cl::Program>> OpenCLBackend::precompileRegisteredKernels() {
+    std::vector<KernelId> ids;
+    {
+        std::shared_lock lock { registryMutex_ };
+        ids.reserve(registry_.size());
+        for (const auto& [id, base] : registry_) {
+            ids.push_back(id);
+        }
+    }
+
+    std::vector<std::shared_future<cl::Program>> result;
+    result.reserve(ids.size());
+    for (const auto& id : ids) {
+        result.push_back(compileProgramAsync(id));
+    }
+    return result;
 }
 
 const KernelBase &OpenCLBackend::findKernelBase(KernelId id) const {
+    // entries are never erased from registry, so returned reference stays valid after lock is released
+    std::shared_lock lock { registryMutex_ };
     const auto kernelSettingsIt = this->registry_.find(id);
     if (kernelSettingsIt == registry_.end()) {
         auto err = fmt::format("No kernel with id {{{}, {}}} was found in registry!", id.src, id.settings);
@@ -41,13 +373,102 @@ const KernelBase &OpenCLBackend::findKernelBase(KernelId id) const {
 }
 
 void OpenCLBackend::registerKernel(KernelId id, KernelBase&& base) {
+    std::unique_lock lock { registryMutex_ };
+    // registered bases are never replaced, as findKernelBase hands out references to them without lock
     auto res = registry_.try_emplace(id, std::forward<KernelBase>(base));
-    logger->info(
-        fmt::format("Kernel ({}, {}) was {}", id.src, id.settings, res.second ? "REGISTERED" : "UPDATED")
-    );
+    if (res.second) {
+        logger->info(fmt::format("Kernel ({}, {}) was REGISTERED", id.src, id.settings));
+    } else {
+        logger->warn(fmt::format(
+            "Kernel ({}, {}) is already registered, new registration is ignored", id.src, id.settings
+        ));
+    }
 }
 
 void OpenCLBackend::clearCache() {
     logger->info("Clearing CL backend cache...");
+    std::unique_lock lock { compileCacheMutex_ };
+    for (const auto& [key, entry] : programEntries_) {
+        if (entry.reclaimable) {
+            memoryBudget_->removeReclaimable(*entry.reclaimable);
+        }
+        memoryBudget_->free(DeviceMemoryOwner::Program, entry.bytes);
+    }
+    programEntries_.clear();
     compileCache_.clear();
+    specializations_.clear();
+    ++cacheGeneration_;
+}
+
+void OpenCLBackend::enableCoExecution() {
+    if (!coExecution_) {
+        coExecution_ = std::make_unique<CoExecutionScheduler>();
+    }
+}
+
+/**
+ * Whether device reports OpenCL 1.2 or later, which sub-devices and their device queries need.
+ */
+static bool supportsSubDevices(const cl::Device& device) {
+    int major = 0, minor = 0;
+    std::sscanf(device.getInfo<CL_DEVICE_VERSION>().c_str(), "OpenCL %d.%d", &major, &minor);
+    return major > 1 || (major == 1 && minor >= 2);
+}
+
+void OpenCLBackend::partitionQueues(double interactiveFraction) {
+    auto device = queue.getInfo<CL_QUEUE_DEVICE>();
+    auto computeUnits = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+    // querying partition properties of 1.1 devices fails, they simply get a separate queue
+    std::vector<cl_device_partition_property> partitionTypes;
+    if (supportsSubDevices(device)) {
+        try {
+            partitionTypes = device.getInfo<CL_DEVICE_PARTITION_PROPERTIES>();
+        } catch (const cl::Error& e) {
+            logger->warn(fmt::format(
+                "Cannot query partition properties of device {}: {} ({})",
+                device.getInfo<CL_DEVICE_NAME>(), e.what(), e.err()
+            ));
+        }
+    }
+    bool byCountsSupported = std::find(
+        partitionTypes.begin(), partitionTypes.end(), CL_DEVICE_PARTITION_BY_COUNTS
+    ) != partitionTypes.end();
+
+    if ((device.getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_CPU) && byCountsSupported && computeUnits >= 2) {
+        auto interactiveUnits = static_cast<cl_uint>(std::clamp(
+            std::lround(computeUnits * interactiveFraction), 1l, static_cast<long>(computeUnits) - 1
+        ));
+        cl_device_partition_property properties[] = {
+            CL_DEVICE_PARTITION_BY_COUNTS,
+            static_cast<cl_device_partition_property>(interactiveUnits),
+            static_cast<cl_device_partition_property>(computeUnits - interactiveUnits),
+            CL_DEVICE_PARTITION_BY_COUNTS_LIST_END,
+            0
+        };
+        try {
+            std::vector<cl::Device> subDevices;
+            device.createSubDevices(properties, &subDevices);
+
+            ctx = cl::Context { subDevices };
+            queue = cl::CommandQueue { ctx, subDevices[0], CL_QUEUE_PROFILING_ENABLE };
+            batchQueue_ = cl::CommandQueue { ctx, subDevices[1], CL_QUEUE_PROFILING_ENABLE };
+            clearCache();
+            memoryPool_->trim();
+
+            logger->info(fmt::format(
+                "Device {} partitioned: {} compute units for interactive jobs, {} for batch jobs",
+                device.getInfo<CL_DEVICE_NAME>(), interactiveUnits, computeUnits - interactiveUnits
+            ));
+            return;
+        } catch (const cl::Error& e) {
+            logger->warn(fmt::format(
+                "Failed to partition device {}: {} ({})", device.getInfo<CL_DEVICE_NAME>(), e.what(), e.err()
+            ));
+        }
+    }
+
+    batchQueue_ = cl::CommandQueue { ctx, device, CL_QUEUE_PROFILING_ENABLE };
+    logger->info(fmt::format(
+        "Device {} cannot be partitioned, batch jobs use a separate queue", device.getInfo<CL_DEVICE_NAME>()
+    ));
 }
@@ -3,85 +3,336 @@
 
 #include "OpenCL.hpp"
 
+#include "DeviceMemoryBudget.hpp"
+#include "DeviceMemoryPool.hpp"
+#include "LaunchTuner.hpp"
 #include "OpenCLKernelUtils.hpp"
+#include "ProgramBinaryCache.hpp"
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
 #include "Utility.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 #include <optional>
 
-struct KernelId {
-    std::string src;
-    std::string settings;
-
-    bool operator==(const KernelId& other) const {
-        return other.src == src && other.settings == settings;
-    }
-};
+class CoExecutionScheduler;
 
 struct CompilationContext {
     KernelId id;
     cl::Context ctx;
+    /**
+     * Compile options added to those of kernel base, e.g. for specialized variants.
+     */
+    std::string options;
 
     bool operator==(const CompilationContext& other) const {
-        return other.id == id && other.ctx() == ctx();
+        return other.id == id && other.ctx() == ctx() && other.options == options;
     }
 };
 
 namespace std {
-    template<> struct hash<KernelId> {
-        size_t operator()(const KernelId& id) const noexcept {
-            auto h1 = std::hash <std::string> {} (id.src);
-            auto h2 = std::hash <std::string> {} (id.settings);
-            return 31 * h1 + h2; // classic hash combine
-        }
-    };
-
     template<> struct hash<CompilationContext> {
         size_t operator()(const CompilationContext& ctx) const noexcept {
             auto h1 = std::hash <KernelId> {} (ctx.id);
             auto h2 = std::hash <cl_context> {} (ctx.ctx());
-            return 31 * h1 + h2;
+            auto h3 = std::hash <std::string> {} (ctx.options);
+            return 31 * (31 * h1 + h2) + h3;
         }
     };
 }
 
+/**
+ * Launch configurations are tuned per kernel variant and image size.
+ */
+struct LaunchConfigurationKey {
+    KernelId id;
+    size_t width, height;
+    /**
+     * Specialization options of the variant being tuned.
+     */
+    std::string options;
+
+    bool operator==(const LaunchConfigurationKey& other) const {
+        return other.id == id && other.width == width && other.height == height && other.options == options;
+    }
+};
+
+namespace std {
+    template<> struct hash<LaunchConfigurationKey> {
+        size_t operator()(const LaunchConfigurationKey& key) const noexcept {
+            auto h1 = std::hash <KernelId> {} (key.id);
+            auto h2 = std::hash <size_t> {} (key.width * 65521 + key.height);
+            auto h3 = std::hash <std::string> {} (key.options);
+            return 31 * (31 * h1 + h2) + h3;
+        }
+    };
+}
+
+/**
+ * Priority of a computation. Interactive jobs never queue behind batch jobs once device is partitioned.
+ */
+enum class JobPriority {
+    Interactive, Batch
+};
+
 /**
  * OpenCL Backend. Keeps everything related to OpenCL computations together.
+ *
+ * Queues are created with profiling enabled; commands enqueued for a kernel are recorded in profiler().
+ *
+ * Backend is safe to use from multiple threads. Every thread receives its own clone of cl::Kernel,
+ * because setting arguments on a shared kernel object is not thread-safe. Clones keep their programs alive, so
+ * a thread drops those it has not used for kernelCloneIdleTime.
  */
 class OpenCLBackend {
 
+public:
+
+    static constexpr std::chrono::seconds kernelCloneIdleTime { 10 };
+
+private:
+
     cl::Context ctx;
 
     cl::CommandQueue queue;
 
+    cl::CommandQueue batchQueue_;
+
     std::unordered_map<KernelId, KernelBase> registry_;
 
-    std::unordered_map<CompilationContext, cl::Kernel> compileCache_;
+    mutable std::shared_mutex registryMutex_;
+
+    /**
+     * Programs which are compiled or being compiled. Pending entries deduplicate concurrent requests.
+     */
+    std::unordered_map<CompilationContext, std::shared_future<cl::Program>> compileCache_;
+
+    std::shared_mutex compileCacheMutex_;
+
+    struct ProgramEntry {
+        size_t bytes = 0;
+        /**
+         * Kernel clones of program held by threads.
+         */
+        size_t kernels = 0;
+        /**
+         * Budget entry while program has no kernel clones; evicting a program with clones would free nothing.
+         */
+        std::optional<DeviceMemoryBudget::EntryHandle> reclaimable;
+    };
+
+    /**
+     * Compiled programs of current context accounted in budget. Guarded by compileCacheMutex_.
+     */
+    std::unordered_map<CompilationContext, ProgramEntry> programEntries_;
+
+    struct Specialization {
+        std::shared_future<cl::Program> program;
+        bool failed = false;
+        bool active = false;
+    };
+
+    /**
+     * Specialized variants requested by compileSpecializedKernel. Guarded by compileCacheMutex_.
+     */
+    std::unordered_map<CompilationContext, Specialization> specializations_;
+
+    /**
+     * Launch configurations being tuned or tuned, per kernel variant and image size.
+     */
+    std::unordered_map<LaunchConfigurationKey, std::shared_future<LaunchConfiguration>> launchConfigurations_;
+
+    std::mutex launchConfigurationsMutex_;
+
+    /**
+     * Incremented on every cache clear; per-thread kernel clones of older generations are discarded.
+     */
+    std::atomic<uint64_t> cacheGeneration_ {0};
+
+    const uint64_t instanceId_;
+
+    /**
+     * Shared with kernel clones kept by threads, which may outlive backend. backend is reset on destruction.
+     */
+    struct Liveness {
+        std::mutex mutex;
+        OpenCLBackend* backend;
+    };
+
+    std::shared_ptr<Liveness> liveness_;
+
+    ProgramBinaryCache binaryCache_;
+
+    ThreadPool compilePool_;
+
+    std::unique_ptr<CoExecutionScheduler> coExecution_;
+
+    std::shared_ptr<DeviceMemoryBudget> memoryBudget_;
+
+    Profiler profiler_;
+
+    /**
+     * Shared, so that images can return their memory to the pool even if they outlive backend.
+     */
+    std::shared_ptr<DeviceMemoryPool> memoryPool_;
+
+    /**
+     * Single thread benchmarking launch configurations, so that tuning neither holds compile threads nor runs
+     * several benchmarks on the device at once. Declared last, so that it is joined before anything else goes.
+     */
+    ThreadPool tuningPool_ { 1 };
+
+    cl::Kernel compileCLKernel(KernelId, const cl::Context&, const std::string& options = {});
 
-    cl::Kernel compileCLKernel(KernelId);
+    /**
+     * Per-thread clone of kernel from program, which is only requested if there is no clone yet.
+     */
+    cl::Kernel cloneKernel(const CompilationContext&, const std::function<cl::Program()>& program);
+
+    /**
+     * Specialized kernel for given args if it is already compiled, generic one otherwise.
+     */
+    cl::Kernel selectSpecializedKernel(KernelId, const KernelArgs&, const cl::Context&, const std::string& options);
+
+    void accountProgram(const CompilationContext&, const cl::Program&);
+
+    /**
+     * Register program as reclaimable. compileCacheMutex_ must be held.
+     */
+    DeviceMemoryBudget::EntryHandle makeProgramReclaimable(const CompilationContext&, size_t bytes);
+
+    /**
+     * Mark program as used by a kernel clone until returned lease is released.
+     */
+    std::shared_ptr<void> acquireProgram(const CompilationContext&);
+
+    void releaseProgram(const CompilationContext&);
+
+    OpenCLBackend(cl::Context, cl::CommandQueue);
 
 public:
 
+    /**
+     * Create backend on the default OpenCL device.
+     */
     OpenCLBackend();
 
+    /**
+     * Create backend on given device.
+     */
+    explicit OpenCLBackend(const cl::Device&);
+
+    ~OpenCLBackend();
+
     inline cl::Context currentContext() noexcept { return ctx; }
 
-    inline cl::CommandQueue currentQueue() noexcept { return queue; }
+    inline cl::CommandQueue currentQueue(JobPriority priority = JobPriority::Interactive) noexcept {
+        return priority == JobPriority::Interactive ? queue : batchQueue_;
+    }
+
+    /**
+     * Split device into interactive and batch slices, each with its own queue. CPU devices are partitioned
+     * with clCreateSubDevices; on other devices batch jobs get a separate queue on the same device.
+     * Changes current context, so must be called before any computations. Only worth it in processes which run
+     * batch jobs next to interactive ones: interactive jobs lose the batch slice.
+     */
+    void partitionQueues(double interactiveFraction = 0.5);
 
     template<typename T>
     KernelInstance<T> compileKernel(KernelId id) {
-        return { compileCLKernel(id) };
+        return { compileCLKernel(std::move(id), ctx) };
+    }
+
+    /**
+     * Compile kernel for a context other than current one (e.g. for another device).
+     */
+    template<typename T>
+    KernelInstance<T> compileKernel(KernelId id, const cl::Context& context) {
+        return { compileCLKernel(std::move(id), context) };
+    }
+
+    /**
+     * Compile kernel specialized for given argument values (see KernelBase::specializableArgs) and built with
+     * given extra options. While the specialized variant is being compiled in background, generic kernel is
+     * returned, so frames are never delayed by specialization. Kernel arguments are the same for both variants.
+     */
+    template<typename T>
+    KernelInstance<T> compileSpecializedKernel(KernelId id, const KernelArgs& args, const std::string& options = {}) {
+        return { selectSpecializedKernel(std::move(id), args, ctx, options) };
     }
 
+    template<typename T>
+    KernelInstance<T> compileSpecializedKernel(KernelId id, const KernelArgs& args, const cl::Context& context) {
+        return { selectSpecializedKernel(std::move(id), args, context, {}) };
+    }
+
+    /**
+     * Options of the variant compileSpecializedKernel selects for given args and extra options; empty for generic
+     * one. Together with id and context, they make the key the variant is compiled and cached under.
+     */
+    std::string specializedOptions(const KernelId&, const KernelArgs&, const cl::Context&,
+                                   const std::string& extraOptions = {});
+
+    /**
+     * Tuned launch configuration of kernel on the interactive device, for the variant specialized for args and
+     * given image size. The first call for a variant and size starts tuning with given args on the interactive queue,
+     * so that it is timed on the same device (or slice of it) frames run on; until it is finished, default
+     * configuration is returned, unless wait is set.
+     */
+    LaunchConfiguration launchConfiguration(const KernelId&, const KernelArgs&, size_t width, size_t height,
+                                            bool wait = false);
+
+    /**
+     * Compile kernel program on a background thread. Repeated requests for the same kernel share a single
+     * compilation. Once the future is ready, compileKernel returns immediately.
+     */
+    std::shared_future<cl::Program> compileProgramAsync(KernelId);
+
+    std::shared_future<cl::Program> compileProgramAsync(KernelId, const cl::Context&, const std::string& options = {});
+
+    /**
+     * Start background compilation of every registered kernel.
+     */
+    std::vector<std::shared_future<cl::Program>> precompileRegisteredKernels();
+
     const KernelBase& findKernelBase(KernelId) const;
 
     /**
-     * Make mapping id -> base
+     * Make mapping id -> base. Registering an id again is ignored.
      */
     void registerKernel(KernelId, KernelBase&&);
 
     void clearCache();
 
+    inline ProgramBinaryCache& binaryCache() noexcept { return binaryCache_; }
+
+    inline const std::shared_ptr<DeviceMemoryPool>& memoryPool() const noexcept { return memoryPool_; }
+
+    /**
+     * Timing of commands enqueued on backend queues, per kernel.
+     */
+    inline Profiler& profiler() noexcept { return profiler_; }
+
+    /**
+     * Device memory accounting. Limit defaults to a fraction of device global memory.
+     */
+    inline DeviceMemoryBudget& memoryBudget() noexcept { return *memoryBudget_; }
+
+    /**
+     * Split subsequent image computations across every available OpenCL device.
+     */
+    void enableCoExecution();
+
+    /**
+     * Co-execution scheduler, or nullptr if co-execution is not enabled.
+     */
+    inline CoExecutionScheduler* coExecution() noexcept { return coExecution_.get(); }
+
 };
 
 /**
@@ -0,0 +1,163 @@
+#include "OpenCLImageEngine.hpp"
+
+#include "DefaultKernels.hpp"
+#include "Tracer.hpp"
+
+#include <algorithm>
+
+LOGGER()
+
+/**
+ * Gamma of density tone mapping; above 1 brings out rarely hit pixels.
+ */
+static constexpr float toneMapGamma = 2.2f;
+
+/**
+ * Args of accumulation pass: seed is varied so that the pass plots points not plotted yet.
+ */
+static KernelArgs argsOfPass(KernelArgs args, const ArgsTypesWithNames& types, size_t pass) {
+    auto it = std::find_if(types.begin(), types.end(), [](const auto& t) { return t.second == "seed"; });
+    if (pass == 0 || it == types.end()) {
+        return args;
+    }
+    size_t index = static_cast<size_t>(std::distance(types.begin(), it));
+    auto seedArg = args.find("seed");
+    if (seedArg == args.end()) {
+        seedArg = args.find(index);
+    }
+    uint64_t seed = 0;
+    if (seedArg != args.end()) {
+        seed = std::visit([](auto v) -> uint64_t {
+            if constexpr (std::is_integral_v<decltype(v)>) {
+                return static_cast<uint64_t>(v);
+            } else {
+                return 0;
+            }
+        }, seedArg->second.value);
+    }
+    // both halves of seed feed the generator state, so pass number is spread over them
+    seed ^= pass * 0x9E3779B97F4A7C15ull;
+    args.erase("seed");
+    args.erase(index);
+    args["seed"] = KernelArgValue { static_cast<int64_t>(seed) };
+    return args;
+}
+
+/**
+ * Whether images of device are host memory anyway, so that mapping them costs nothing.
+ */
+static bool sharesMemoryWithHost(OpenCLBackend& backend, JobPriority priority) {
+    auto device = backend.currentQueue(priority).getInfo<CL_QUEUE_DEVICE>();
+    return (device.getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_CPU)
+        || device.getInfo<CL_DEVICE_HOST_UNIFIED_MEMORY>() == CL_TRUE;
+}
+
+OpenCLImageEngine::OpenCLImageEngine(
+    OpenCLBackendPtr backend, KernelId kernelId, Range<2> dimensions, JobPriority priority
+)
+    : OpenCLComputableImage<Dim_2D>(backend, dimensions, sharesMemoryWithHost(*backend, priority)),
+      backend_(std::move(backend)),
+      kernelId_(std::move(kernelId)),
+      priority_(priority)
+{
+    if (hostMapped()) {
+        logger->info("Device shares memory with host, frames will be mapped instead of read back");
+    }
+    backend_->compileProgramAsync(kernelId_);
+}
+
+OpenCLImageEngine::~OpenCLImageEngine() {
+    // image goes back to the pool, where it must not stay mapped
+    unmap();
+    backend_->currentQueue(priority_).finish();
+}
+
+bool OpenCLImageEngine::ready() {
+    return backend_->compileProgramAsync(kernelId_).wait_for(std::chrono::seconds::zero()) == std::future_status::ready;
+}
+
+ArgsTypesWithNames OpenCLImageEngine::argTypes() {
+    if (!argTypes_) {
+        argTypes_ = detectArgumentTypesAndNames(backend_->compileKernel<NoUserProperties>(kernelId_).kernel());
+    }
+    return *argTypes_;
+}
+
+bool OpenCLImageEngine::accumulates() {
+    auto types = argTypes();
+    return std::any_of(types.begin(), types.end(), [](const auto& t) { return t.second == "density"; });
+}
+
+void OpenCLImageEngine::resize(size_t width, size_t height) {
+    unmap();
+    // density of the old size cannot be refined further
+    lastArgs_.reset();
+    OpenCLComputableImage<Dim_2D>::resize(backend_, { width, height });
+}
+
+void OpenCLImageEngine::compute(const KernelArgs& args) {
+    unmap();
+    // device-side timing is collected by backend profiler
+    clear(backend_, { 1.0f, 1.0f, 1.0f, 1.0f }, priority_, kernelId_);
+    lastArgs_.reset();
+    if (computePass(args)) {
+        lastArgs_ = args;
+        pass_ = 0;
+    }
+}
+
+bool OpenCLImageEngine::refine() {
+    if (!lastArgs_ || !accumulates()) {
+        return false;
+    }
+    unmap();
+    ++pass_;
+    if (!computePass(argsOfPass(*lastArgs_, argTypes(), pass_))) {
+        // density holds a part of the pass, so it cannot be refined further
+        lastArgs_.reset();
+        return false;
+    }
+    return true;
+}
+
+bool OpenCLImageEngine::computePass(const KernelArgs& args) {
+    auto* slicing = slicing_ ? &*slicing_ : nullptr;
+    if (!OpenCLComputableImage<Dim_2D>::compute<NoUserProperties>(backend_, kernelId_, args, priority_, slicing)) {
+        return false;
+    }
+    if (accumulates()) {
+        toneMap(backend_, TONE_MAP_ID, toneMapGamma, priority_);
+    }
+    // readback blocks anyway, so waiting here only separates compute time from readback time
+    backend_->currentQueue(priority_).finish();
+    return true;
+}
+
+void OpenCLImageEngine::read(uint32_t* pixels) {
+    TRACE_SCOPE("enqueueReadImage")
+    OpenCLComputableImage<Dim_2D>::read(backend_, pixels, priority_, kernelId_, true);
+}
+
+std::optional<MappedImage> OpenCLImageEngine::map() {
+    if (!hostMapped()) {
+        return std::nullopt;
+    }
+    if (!mapping_) {
+        TRACE_SCOPE("enqueueMapImage")
+        mapping_ = OpenCLComputableImage<Dim_2D>::map(backend_, priority_, kernelId_);
+        mapping_->event.wait();
+    }
+    return MappedImage { static_cast<const uint32_t*>(mapping_->pixels), mapping_->rowPitch / sizeof(uint32_t) };
+}
+
+void OpenCLImageEngine::unmap() {
+    if (mapping_) {
+        OpenCLComputableImage<Dim_2D>::unmap(backend_, mapping_->pixels, priority_);
+        mapping_.reset();
+    }
+}
+
+std::optional<RenderStatistics> OpenCLImageEngine::statistics() {
+    // counted on device; only a few bytes are read back
+    return OpenCLComputableImage<Dim_2D>::statistics();
+}
@@ -0,0 +1,73 @@
+#ifndef FRACTALEXPLORER_OPENCLIMAGEENGINE_HPP
+#define FRACTALEXPLORER_OPENCLIMAGEENGINE_HPP
+
+#include "ComputableImage.hpp"
+#include "ImageEngine.hpp"
+
+/**
+ * Image computed by registered OpenCL kernel on backend queue of given priority.
+ *
+ * On devices which share memory with host (CPU devices and integrated GPUs) image is allocated in host-accessible
+ * memory and map() hands it out in place, instead of copying every frame with read().
+ *
+ * Kernels with `density` argument (e.g. NEWTON_FRACTAL_ACCUMULATE_ID) accumulate hits instead of drawing them;
+ * image is then tone mapped from density after every pass, and refine() adds passes with varied seed.
+ */
+class OpenCLImageEngine : public ImageEngine, private OpenCLComputableImage<Dim_2D> {
+
+    OpenCLBackendPtr backend_;
+    const KernelId kernelId_;
+    const JobPriority priority_;
+    std::optional<ArgsTypesWithNames> argTypes_;
+    std::optional<Mapping> mapping_;
+
+    std::optional<KernelArgs> lastArgs_;
+    size_t pass_ = 0;
+
+    std::optional<SlicedDispatch> slicing_;
+
+    bool accumulates();
+
+    /**
+     * Compute args into current image without clearing it, and tone map it if kernel accumulates. Returns false if
+     * cancelled.
+     */
+    bool computePass(const KernelArgs&);
+
+public:
+
+    OpenCLImageEngine(OpenCLBackendPtr backend, KernelId kernelId, Range<2> dimensions,
+                      JobPriority priority = JobPriority::Interactive);
+
+    ~OpenCLImageEngine() override;
+
+    std::string name() const override { return "opencl"; }
+
+    /**
+     * Kernel is compiled in background; until it is done, engine is not ready.
+     */
+    bool ready() override;
+
+    ArgsTypesWithNames argTypes() override;
+
+    void resize(size_t width, size_t height) override;
+
+    void setSlicedDispatch(std::optional<SlicedDispatch> slicing) override { slicing_ = std::move(slicing); }
+
+    void compute(const KernelArgs&) override;
+
+    bool refine() override;
+
+    void read(uint32_t* pixels) override;
+
+    std::optional<MappedImage> map() override;
+
+    void unmap() override;
+
+    std::optional<RenderStatistics> statistics() override;
+
+    inline const OpenCLBackendPtr& backend() const noexcept { return backend_; }
+
+};
+
+#endif //FRACTALEXPLORER_OPENCLIMAGEENGINE_HPP
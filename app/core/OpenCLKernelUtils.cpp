@@ -201,6 +201,35 @@ ArgsTypesWithNames detectArgumentTypesAndNames(const cl::Kernel &kernel) {
     return types;
 }
 
+KernelArgValue convertArgValue(const KernelArgValue& value, KernelArgType type) {
+    auto traits = findTypeTraits(type);
+    if (traits.klass == KernelArgTypeClass::Memory) {
+        return value;
+    }
+    std::vector<Primitive> components(traits.numComponents);
+    for (size_t i = 0; i < components.size(); ++i) {
+        components[i] = std::visit([](auto v) { return static_cast<Primitive>(v); }, getVectorComponent(i, value.value));
+    }
+    return traits.fromVector(components);
+}
+
+KernelArgs convertArgs(const ArgsTypesWithNames& types, const KernelArgs& args) {
+    KernelArgs result;
+    for (const auto& [key, value] : args) {
+        auto type = std::visit([&types](auto&& k) {
+            using Type = typename std::decay<decltype(k)>::type;
+            if constexpr (std::is_same_v<Type, std::string>) {
+                auto it = std::find_if(types.begin(), types.end(), [&k](const auto& t) { return t.second == k; });
+                return it == types.end() ? KernelArgType::Unknown : it->first;
+            } else {
+                return k < types.size() ? types[k].first : KernelArgType::Unknown;
+            }
+        }, key);
+        result.emplace(key, type == KernelArgType::Unknown ? value : convertArgValue(value, type));
+    }
+    return result;
+}
+
 /**
  * Helper function to fetch build log for a program.
  */
@@ -219,15 +248,54 @@ std::string getBuildLog(const cl::Context &ctx, const cl::Program& prg) {
 
 KernelBase::KernelBase(
     cl::Program::Sources sourceCode,
-    std::vector<std::string> compileOptions)
+    std::vector<std::string> compileOptions,
+    std::vector<std::string> specializableArgs)
     :   sourceCode_(std::move(sourceCode)),
-        compileOptions_(std::move(compileOptions))
+        compileOptions_(std::move(compileOptions)),
+        specializableArgs_(std::move(specializableArgs))
     {}
 
+std::string KernelBase::optionsString() const {
+    return absl::StrJoin(compileOptions_.begin(), compileOptions_.end(), " ");
+}
+
+std::string KernelBase::specializationOptions(const KernelArgs& args, const ArgNameMap& names) const {
+    std::vector<std::string> defines;
+    for (const auto& name : specializableArgs_) {
+        auto arg = args.find(name);
+        if (arg == args.end()) {
+            auto idx = names.find(name);
+            if (idx == names.end()) {
+                continue;
+            }
+            arg = args.find(static_cast<size_t>(idx->second));
+            if (arg == args.end()) {
+                continue;
+            }
+        }
+        std::visit([&](auto&& value) {
+            using Type = std::decay_t<decltype(value)>;
+            if constexpr (std::is_same_v<Type, cl_int> || std::is_same_v<Type, cl_long>) {
+                defines.push_back(fmt::format("-DSPECIALIZED_{}={}", absl::AsciiStrToUpper(name), value));
+            }
+        }, arg->second.value);
+    }
+    return absl::StrJoin(defines, " ");
+}
+
+KernelBase KernelBase::withOptions(const std::string& extraOptions) const {
+    auto copy = *this;
+    if (!extraOptions.empty()) {
+        copy.compileOptions_.push_back(extraOptions);
+    }
+    return copy;
+}
+
 cl::Program KernelBase::build(const cl::Context& ctx) const {
+    TRACE_SCOPE("KernelBase::build")
     cl::Program prg (ctx, sourceCode_);
 
-    auto options = absl::StrJoin(compileOptions_.begin(), compileOptions_.end(), " ");
+    auto options = optionsString();
 
     logger->info(fmt::format("Building program with options: {}", options));
 
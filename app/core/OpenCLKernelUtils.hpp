@@ -2,6 +2,7 @@
 #define FRACTALEXPLORER_OPENCLKERNELUTILS_HPP
 
 #include <OpenCL.hpp>
+#include <Tracer.hpp>
 #include <Utility.hpp>
 
 #include <variant>
@@ -146,6 +147,7 @@ using KernelArgs = std::unordered_map<std::variant<std::string, size_t>, KernelA
  */
 template <typename Iter>
 void applyArgsToKernel(cl::Kernel &kernel, Iter begin, Iter end) {
+    TRACE_SCOPE("applyArgsToKernel")
     auto nameMap = mapNamesToArgIndices(kernel);
     std::for_each(
         begin, end, [&](const auto &value) {
@@ -208,18 +210,50 @@ using ArgsTypesWithNames = std::vector<std::pair<KernelArgType, std::string>>;
  */
 ArgsTypesWithNames detectArgumentTypesAndNames(const cl::Kernel &kernel);
 
+/**
+ * Convert value to the representation of given argument type (e.g. double2 -> float2 for devices
+ * without fp64 support). Memory types are returned as is.
+ */
+KernelArgValue convertArgValue(const KernelArgValue&, KernelArgType);
+
+/**
+ * Convert arguments to types of corresponding kernel arguments.
+ */
+KernelArgs convertArgs(const ArgsTypesWithNames&, const KernelArgs&);
+
+struct KernelId {
+    std::string src;
+    std::string settings;
+
+    bool operator==(const KernelId& other) const {
+        return other.src == src && other.settings == settings;
+    }
+};
+
+namespace std {
+    template<> struct hash<KernelId> {
+        size_t operator()(const KernelId& id) const noexcept {
+            auto h1 = std::hash <std::string> {} (id.src);
+            auto h2 = std::hash <std::string> {} (id.settings);
+            return 31 * h1 + h2; // classic hash combine
+        }
+    };
+}
+
 /**
  * A set of properties from which a kernel instance can be built.
  */
 class KernelBase {
     cl::Program::Sources sourceCode_;
     std::vector<std::string> compileOptions_;
+    std::vector<std::string> specializableArgs_;
 
 public:
 
     KernelBase(
         cl::Program::Sources sourceCode,
-        std::vector<std::string> compileOptions
+        std::vector<std::string> compileOptions,
+        std::vector<std::string> specializableArgs = {}
         );
 
     inline const auto& sources() const { return sourceCode_; }
@@ -230,6 +264,28 @@ public:
 
     inline void options(std::vector<std::string> opt) { compileOptions_ = std::move(opt); }
 
+    /**
+     * Integer arguments which can be baked into a program as -DSPECIALIZED_<NAME>=<value>. Kernel source
+     * is expected to use the define instead of the argument when it is present.
+     */
+    inline const auto& specializableArgs() const { return specializableArgs_; }
+
+    /**
+     * Compile options joined in the form they are passed to the OpenCL compiler.
+     */
+    std::string optionsString() const;
+
+    /**
+     * Options specializing this kernel for given argument values, e.g. "-DSPECIALIZED_T=1". Only integer
+     * arguments are specialized; empty if none of specializable arguments is present in args.
+     */
+    std::string specializationOptions(const KernelArgs& args, const ArgNameMap& names) const;
+
+    /**
+     * Copy of this base with extra compile options appended.
+     */
+    KernelBase withOptions(const std::string& extraOptions) const;
+
     cl::Program build(const cl::Context&) const;
 };
 
@@ -342,6 +398,28 @@ KernelArgProperties<UserArgProperties> propertiesFromConfig(const ArgsTypesWithN
     return result;
 }
 
+/**
+ * Default values of non-memory arguments, keyed by index. Properties must be listed for every argument in order,
+ * as in configurations parsed by propertiesFromConfig.
+ */
+template <typename UserArgProperties>
+KernelArgs defaultArgValues(const ArgsTypesWithNames& argDict, const KernelArgProperties<UserArgProperties>& props) {
+    if (argDict.size() != props.size()) {
+        LOGGER();
+        auto err = fmt::format("Inconsistent sizes argTypes ({}) vs conf ({})", argDict.size(), props.size());
+        logger->error(err);
+        throw std::runtime_error(err);
+    }
+
+    KernelArgs result;
+    for (size_t i = 0; i < props.size(); ++i) {
+        if (findTypeTraits(argDict[i].first).klass != KernelArgTypeClass::Memory) {
+            result[i] = props[i].defaultValue();
+        }
+    }
+    return result;
+}
+
 /**
  * Low-level cl::Kernel instance enriched by argument metainfo.
  *
@@ -359,7 +437,7 @@ class KernelInstance {
 public:
 
     KernelInstance(cl::Kernel kernel, KernelArgProperties<UserArgProperties> props)
-    : kernel_(std::move(kernel)), argProps_(std::move(props)), nameMap_(mapNamesToArgIndices(kernel))
+    : kernel_(std::move(kernel)), argProps_(std::move(props)), nameMap_(mapNamesToArgIndices(kernel_))
     {
         imageArgIdx_ = detectImageArgIdx(nameMap_);
         dimensionalArgs_ = detectImageDimensionalArgIdxs(nameMap_);
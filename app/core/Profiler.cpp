@@ -0,0 +1,124 @@
+#include "Profiler.hpp"
+
+#include "Tracer.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+
+LOGGER()
+
+const char* to_string(ProfiledOperation operation) {
+    switch (operation) {
+        case ProfiledOperation::Fill: return "fill";
+        case ProfiledOperation::Kernel: return "kernel";
+        case ProfiledOperation::Read: return "read";
+        case ProfiledOperation::Write: return "write";
+        case ProfiledOperation::Map: return "map";
+    }
+    return "unknown";
+}
+
+Profiler::Profiler(std::chrono::seconds logInterval)
+    : logInterval_(logInterval), lastLog_(std::chrono::steady_clock::now())
+{}
+
+void Profiler::record(const KernelId& id, ProfiledOperation operation, cl::Event event, size_t bytes) {
+    if (event() == nullptr) {
+        return;
+    }
+    bool logDue;
+    {
+        std::lock_guard lock { mutex_ };
+        pending_.push_back({ id, operation, std::move(event), bytes, std::chrono::steady_clock::now() });
+        collectLocked();
+        logDue = std::chrono::steady_clock::now() - lastLog_ >= logInterval_;
+    }
+    if (logDue) {
+        logStatistics();
+    }
+}
+
+void Profiler::collect() {
+    std::lock_guard lock { mutex_ };
+    collectLocked();
+}
+
+void Profiler::collectLocked() {
+    auto completed = std::partition(pending_.begin(), pending_.end(), [](const Pending& p) {
+        return p.event.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>() > CL_COMPLETE;
+    });
+    for (auto it = completed; it != pending_.end(); ++it) {
+        if (it->event.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>() < 0) {
+            // command was terminated abnormally, there are no timestamps
+            continue;
+        }
+        try {
+            add({
+                it->id, it->operation, it->bytes, it->hostEnqueued,
+                it->event.getProfilingInfo<CL_PROFILING_COMMAND_QUEUED>(),
+                it->event.getProfilingInfo<CL_PROFILING_COMMAND_SUBMIT>(),
+                it->event.getProfilingInfo<CL_PROFILING_COMMAND_START>(),
+                it->event.getProfilingInfo<CL_PROFILING_COMMAND_END>(),
+            });
+        } catch (const cl::Error& e) {
+            // queue was created without CL_QUEUE_PROFILING_ENABLE
+            LOG_DEBUG("No profiling info for {} event: {}", to_string(it->operation), e.err());
+        }
+    }
+    pending_.erase(completed, pending_.end());
+}
+
+void Profiler::add(const ProfiledEvent& event) {
+    auto& acc = accumulated_[event.id][static_cast<size_t>(event.operation)];
+    acc.execution.add((event.end - event.start) * 1e-6);
+    acc.wait.add((event.start - event.queued) * 1e-6);
+    acc.bytes += event.bytes;
+
+    if (Tracer::enabled()) {
+        // device clock is not related to host one; anchor command on host time at which it was enqueued
+        auto start = event.hostEnqueued + std::chrono::nanoseconds { event.start - event.queued };
+        Tracer::instance().deviceSpan(
+            fmt::format("{} ({}, {})", to_string(event.operation), event.id.src, event.id.settings), "device",
+            start, start + std::chrono::nanoseconds { event.end - event.start }
+        );
+    }
+}
+
+std::unordered_map<KernelId, Profiler::KernelStatistics> Profiler::statistics() {
+    std::lock_guard lock { mutex_ };
+    collectLocked();
+
+    std::unordered_map<KernelId, KernelStatistics> result;
+    for (const auto& [id, operations] : accumulated_) {
+        auto& stats = result[id];
+        for (size_t i = 0; i < operations.size(); ++i) {
+            stats[i] = { operations[i].execution.summary(), operations[i].wait.summary(), operations[i].bytes };
+        }
+    }
+    return result;
+}
+
+void Profiler::logStatistics() {
+    auto stats = statistics();
+    {
+        std::lock_guard lock { mutex_ };
+        lastLog_ = std::chrono::steady_clock::now();
+    }
+
+    for (const auto& [id, operations] : stats) {
+        std::string line;
+        for (size_t i = 0; i < operations.size(); ++i) {
+            const auto& op = operations[i];
+            if (op.execution.count == 0) {
+                continue;
+            }
+            line += fmt::format(
+                " | {} x{}: mean {:.2f} p50 {:.2f} p95 {:.2f} p99 {:.2f} ms, wait p50 {:.2f} ms, {} KiB",
+                to_string(static_cast<ProfiledOperation>(i)), op.execution.count,
+                op.execution.mean, op.execution.p50, op.execution.p95, op.execution.p99,
+                op.wait.p50, op.bytes / 1024
+            );
+        }
+        logger->info(fmt::format("Profile ({}, {}){}", id.src, id.settings, line));
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef FRACTALEXPLORER_PROFILER_HPP
+#define FRACTALEXPLORER_PROFILER_HPP
+
+#include "OpenCL.hpp"
+
+#include "OpenCLKernelUtils.hpp"
+#include "RollingStatistics.hpp"
+
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Kind of device command.
+ */
+enum class ProfiledOperation {
+    Fill, Kernel, Read, Write, Map
+};
+
+const char* to_string(ProfiledOperation);
+
+/**
+ * Device timestamps of a single completed command, in nanoseconds of device clock.
+ */
+struct ProfiledEvent {
+    KernelId id;
+    ProfiledOperation operation;
+    size_t bytes;
+    std::chrono::steady_clock::time_point hostEnqueued;
+    cl_ulong queued, submit, start, end;
+};
+
+/**
+ * Collects timing of device commands per KernelId. Queues should be created with CL_QUEUE_PROFILING_ENABLE.
+ *
+ * Events are recorded when commands are enqueued and read lazily once they complete, so recording never blocks.
+ */
+class Profiler {
+
+public:
+
+    struct OperationStatistics {
+        RollingStatistics::Summary execution; // start -> end, ms
+        RollingStatistics::Summary wait;      // queued -> start, ms
+        size_t bytes = 0;
+    };
+
+    using KernelStatistics = std::array<OperationStatistics, 5>;
+
+    explicit Profiler(std::chrono::seconds logInterval = std::chrono::seconds { 10 });
+
+    void record(const KernelId&, ProfiledOperation, cl::Event, size_t bytes = 0);
+
+    /**
+     * Process all completed events.
+     */
+    void collect();
+
+    std::unordered_map<KernelId, KernelStatistics> statistics();
+
+    /**
+     * Log statistics of every kernel, one line per kernel.
+     */
+    void logStatistics();
+
+private:
+
+    struct Pending {
+        KernelId id;
+        ProfiledOperation operation;
+        cl::Event event;
+        size_t bytes;
+        std::chrono::steady_clock::time_point hostEnqueued;
+    };
+
+    struct Accumulated {
+        RollingStatistics execution, wait;
+        size_t bytes = 0;
+    };
+
+    std::vector<Pending> pending_;
+
+    std::unordered_map<KernelId, std::array<Accumulated, 5>> accumulated_;
+
+    std::chrono::steady_clock::duration logInterval_;
+
+    std::chrono::steady_clock::time_point lastLog_;
+
+    std::mutex mutex_;
+
+    void collectLocked();
+
+    void add(const ProfiledEvent&);
+
+};
+
+#endif //FRACTALEXPLORER_PROFILER_HPP
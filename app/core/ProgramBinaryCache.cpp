@@ -0,0 +1,242 @@
+#include "ProgramBinaryCache.hpp"
+
+#include "Utility.hpp"
+
+#include <fstream>
+#include <thread>
+
+LOGGER()
+
+static constexpr char entryMagic[4] = { 'F', 'E', 'P', 'B' };
+static constexpr uint32_t entryVersion = 2;
+
+template <typename T>
+static void writePod(std::ostream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool readPod(std::istream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return static_cast<bool>(in);
+}
+
+/**
+ * Retrieve binaries of a built program, one per device in the order of CL_PROGRAM_DEVICES.
+ */
+static std::vector<std::vector<unsigned char>> programBinaries(const cl::Program& prg) {
+    auto sizes = prg.getInfo<CL_PROGRAM_BINARY_SIZES>();
+
+    std::vector<std::vector<unsigned char>> binaries(sizes.size());
+    std::vector<unsigned char*> pointers(sizes.size());
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        binaries[i].resize(sizes[i]);
+        pointers[i] = binaries[i].data();
+    }
+
+    auto err = clGetProgramInfo(
+        prg(), CL_PROGRAM_BINARIES, pointers.size() * sizeof(unsigned char*), pointers.data(), nullptr);
+    if (err != CL_SUCCESS) {
+        throw cl::Error(err, "clGetProgramInfo(CL_PROGRAM_BINARIES)");
+    }
+    return binaries;
+}
+
+ProgramBinaryCache::ProgramBinaryCache(std::filesystem::path directory)
+    : directory_(std::move(directory))
+{}
+
+void ProgramBinaryCache::addReadOnlyDirectory(std::filesystem::path directory) {
+    logger->info(fmt::format("Using read-only program cache directory {}", directory.string()));
+    readOnlyDirectories_.push_back(std::move(directory));
+}
+
+std::string ProgramBinaryCache::entryKey(const KernelBase& base, const cl::Context& ctx) const {
+    std::string key;
+    for (const auto& [data, size] : base.sources()) {
+        key.append(data, size);
+        key.push_back('\0');
+    }
+    key.append(base.optionsString());
+    key.push_back('\0');
+    for (const auto& device : ctx.getInfo<CL_CONTEXT_DEVICES>()) {
+        cl::Platform platform { device.getInfo<CL_DEVICE_PLATFORM>() };
+        key.append(platform.getInfo<CL_PLATFORM_NAME>());
+        key.append(platform.getInfo<CL_PLATFORM_VERSION>());
+        key.append(device.getInfo<CL_DEVICE_NAME>());
+        key.append(device.getInfo<CL_DRIVER_VERSION>());
+        key.push_back('\0');
+    }
+    return key;
+}
+
+std::optional<cl::Program> ProgramBinaryCache::tryLoad(
+    const std::filesystem::path& path, const std::string& key, const KernelBase& base, const cl::Context& ctx,
+    std::chrono::microseconds& buildTime
+) {
+    std::ifstream in { path, std::ios::binary };
+    if (!in) {
+        return {};
+    }
+
+    char magic[sizeof(entryMagic)];
+    uint32_t version, numBinaries;
+    uint64_t keySize;
+    int64_t micros;
+    in.read(magic, sizeof(magic));
+    if (!in || !std::equal(std::begin(magic), std::end(magic), std::begin(entryMagic))
+        || !readPod(in, version) || version != entryVersion || !readPod(in, keySize)) {
+        logger->warn(fmt::format("Program cache entry {} is malformed, ignoring", path.string()));
+        return {};
+    }
+
+    // entries are named by hash of their key, so key is compared before binaries are even read
+    if (keySize != key.size()) {
+        logger->warn(fmt::format("Program cache entry {} belongs to another program, ignoring", path.string()));
+        return {};
+    }
+    std::string storedKey(keySize, '\0');
+    in.read(storedKey.data(), static_cast<std::streamsize>(keySize));
+    if (!in || !readPod(in, micros) || !readPod(in, numBinaries)) {
+        logger->warn(fmt::format("Program cache entry {} is malformed, ignoring", path.string()));
+        return {};
+    }
+    if (storedKey != key) {
+        logger->warn(fmt::format("Program cache entry {} belongs to another program, ignoring", path.string()));
+        return {};
+    }
+
+    auto devices = ctx.getInfo<CL_CONTEXT_DEVICES>();
+    if (numBinaries != devices.size()) {
+        return {};
+    }
+
+    std::vector<std::vector<unsigned char>> binaries(numBinaries);
+    cl::Program::Binaries clBinaries;
+    clBinaries.reserve(numBinaries);
+    for (auto& binary : binaries) {
+        uint64_t size;
+        if (!readPod(in, size)) {
+            return {};
+        }
+        binary.resize(size);
+        in.read(reinterpret_cast<char*>(binary.data()), static_cast<std::streamsize>(size));
+        if (!in) {
+            logger->warn(fmt::format("Program cache entry {} is truncated, ignoring", path.string()));
+            return {};
+        }
+        clBinaries.emplace_back(binary.data(), binary.size());
+    }
+
+    try {
+        std::vector<cl_int> status;
+        cl::Program prg { ctx, devices, clBinaries, &status };
+        prg.build(devices, base.optionsString().c_str());
+        buildTime = std::chrono::microseconds { micros };
+        return prg;
+    } catch (const cl::Error& e) {
+        ++rejected_;
+        logger->warn(fmt::format(
+            "Program cache entry {} was rejected by OpenCL runtime ({}: {}), rebuilding from sources",
+            path.string(), e.what(), e.err()
+        ));
+        return {};
+    }
+}
+
+void ProgramBinaryCache::store(
+    const std::filesystem::path& path, const std::string& key, const cl::Program& prg,
+    std::chrono::microseconds buildTime
+) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    if (ec) {
+        logger->warn(fmt::format("Cannot create program cache directory {}: {}", directory_.string(), ec.message()));
+        return;
+    }
+
+    auto binaries = programBinaries(prg);
+
+    // write to temporary file first, so that concurrent readers never see a partially written entry
+    auto tmpPath = path;
+    tmpPath += fmt::format(".{:x}.{:x}.tmp",
+        std::hash<std::thread::id> {} (std::this_thread::get_id()),
+        std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+        std::ofstream out { tmpPath, std::ios::binary | std::ios::trunc };
+        out.write(entryMagic, sizeof(entryMagic));
+        writePod(out, entryVersion);
+        writePod(out, static_cast<uint64_t>(key.size()));
+        out.write(key.data(), static_cast<std::streamsize>(key.size()));
+        writePod(out, static_cast<int64_t>(buildTime.count()));
+        writePod(out, static_cast<uint32_t>(binaries.size()));
+        for (const auto& binary : binaries) {
+            writePod(out, static_cast<uint64_t>(binary.size()));
+            out.write(reinterpret_cast<const char*>(binary.data()), static_cast<std::streamsize>(binary.size()));
+        }
+        if (!out) {
+            logger->warn(fmt::format("Failed to write program cache entry {}", tmpPath.string()));
+            std::filesystem::remove(tmpPath, ec);
+            return;
+        }
+    }
+
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        logger->warn(fmt::format("Failed to store program cache entry {}: {}", path.string(), ec.message()));
+        std::filesystem::remove(tmpPath, ec);
+    }
+}
+
+cl::Program ProgramBinaryCache::build(const KernelBase& base, const cl::Context& ctx) {
+    auto key = entryKey(base, ctx);
+    std::filesystem::path name = fmt::format("{:016x}.bin", contentHash(key));
+    auto path = directory_ / name;
+
+    auto loadStart = std::chrono::steady_clock::now();
+    std::chrono::microseconds buildTime {};
+    auto prg = tryLoad(path, key, base, ctx, buildTime);
+    for (auto dir = readOnlyDirectories_.begin(); !prg && dir != readOnlyDirectories_.end(); ++dir) {
+        prg = tryLoad(*dir / name, key, base, ctx, buildTime);
+    }
+    if (prg) {
+        auto loadTime = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - loadStart);
+        auto saved = std::max(buildTime - loadTime, std::chrono::microseconds::zero());
+        ++hits_;
+        savedMicros_ += saved.count();
+        logger->info(fmt::format(
+            "Program cache HIT {} (loaded in {} ms, saved {} ms; total hits/misses {}/{}, saved {} ms)",
+            name.string(), loadTime.count() / 1000, saved.count() / 1000,
+            hits_.load(), misses_.load(), savedMicros_.load() / 1000
+        ));
+        return *prg;
+    }
+
+    ++misses_;
+    auto buildStart = std::chrono::steady_clock::now();
+    auto built = base.build(ctx);
+    buildTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - buildStart);
+    logger->info(fmt::format(
+        "Program cache MISS {} (built in {} ms; total hits/misses {}/{})",
+        name.string(), buildTime.count() / 1000, hits_.load(), misses_.load()
+    ));
+
+    try {
+        store(path, key, built, buildTime);
+    } catch (const cl::Error& e) {
+        logger->warn(fmt::format("Cannot retrieve program binaries ({}: {}), not caching", e.what(), e.err()));
+    }
+
+    return built;
+}
+
+void ProgramBinaryCache::clear() {
+    std::error_code ec;
+    auto removed = std::filesystem::remove_all(directory_, ec);
+    if (ec) {
+        logger->warn(fmt::format("Failed to clear program cache {}: {}", directory_.string(), ec.message()));
+        return;
+    }
+    logger->info(fmt::format("Program cache {} cleared ({} entries removed)", directory_.string(), removed));
+}
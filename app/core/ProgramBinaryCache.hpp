@@ -0,0 +1,78 @@
+#ifndef FRACTALEXPLORER_PROGRAMBINARYCACHE_HPP
+#define FRACTALEXPLORER_PROGRAMBINARYCACHE_HPP
+
+#include "OpenCL.hpp"
+
+#include "OpenCLKernelUtils.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <optional>
+
+/**
+ * Persistent on-disk cache of compiled OpenCL programs.
+ *
+ * Entries are keyed by the content of program sources, compile options and the devices
+ * (name, driver version, platform) of the context the program is built for. File name is a hash of the key; the
+ * key itself is stored in the entry and compared on load, so colliding entries are never mixed up.
+ */
+class ProgramBinaryCache {
+
+    std::filesystem::path directory_;
+
+    std::vector<std::filesystem::path> readOnlyDirectories_;
+
+    std::atomic<size_t> hits_ {0}, misses_ {0}, rejected_ {0};
+
+    std::atomic<int64_t> savedMicros_ {0};
+
+    std::string entryKey(const KernelBase&, const cl::Context&) const;
+
+    std::optional<cl::Program> tryLoad(
+        const std::filesystem::path&, const std::string& key, const KernelBase&, const cl::Context&,
+        std::chrono::microseconds& buildTime);
+
+    void store(
+        const std::filesystem::path&, const std::string& key, const cl::Program&, std::chrono::microseconds buildTime);
+
+public:
+
+    explicit ProgramBinaryCache(std::filesystem::path directory);
+
+    /**
+     * Load program from cached binaries, or build it from sources and store resulting binaries.
+     */
+    cl::Program build(const KernelBase&, const cl::Context&);
+
+    /**
+     * Additionally look up entries in given directory (e.g. binaries precompiled during the build).
+     * Entries are never written there.
+     */
+    void addReadOnlyDirectory(std::filesystem::path);
+
+    /**
+     * Write entries into given directory instead (e.g. when precompiling). Must be called before any builds.
+     */
+    inline void setDirectory(std::filesystem::path directory) { directory_ = std::move(directory); }
+
+    /**
+     * Remove all entries from disk. Read-only directories are not touched.
+     */
+    void clear();
+
+    inline const std::filesystem::path& directory() const noexcept { return directory_; }
+
+    inline size_t hits() const noexcept { return hits_.load(); }
+
+    inline size_t misses() const noexcept { return misses_.load(); }
+
+    inline size_t rejected() const noexcept { return rejected_.load(); }
+
+    inline std::chrono::microseconds timeSaved() const noexcept {
+        return std::chrono::microseconds { savedMicros_.load() };
+    }
+
+};
+
+#endif //FRACTALEXPLORER_PROGRAMBINARYCACHE_HPP
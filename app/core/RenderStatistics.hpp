@@ -0,0 +1,43 @@
+#ifndef FRACTALEXPLORER_RENDERSTATISTICS_HPP
+#define FRACTALEXPLORER_RENDERSTATISTICS_HPP
+
+#include "OpenCL.hpp"
+
+#include <array>
+
+/**
+ * Counters accumulated on device by kernels which take `global uint* stats` and `global uint* hit_mask`
+ * arguments. Layout of the stats block must match STAT_* definitions in CLC_NewtonFractal.hpp.
+ */
+struct RenderStatistics {
+
+    static constexpr size_t numDeviceCounters = 8;
+
+    using DeviceCounters = std::array<cl_uint, numDeviceCounters>;
+
+    uint64_t pointsGenerated = 0;
+    uint64_t pointsInViewport = 0;
+    uint32_t frozenTrajectories = 0;
+    uint32_t solverFailures = 0;
+    uint32_t distinctPixels = 0;
+
+    static RenderStatistics fromDeviceCounters(const DeviceCounters& c) {
+        RenderStatistics stats;
+        stats.pointsGenerated = c[0] | static_cast<uint64_t>(c[1]) << 32;
+        stats.pointsInViewport = c[2] | static_cast<uint64_t>(c[3]) << 32;
+        stats.frozenTrajectories = c[4];
+        stats.solverFailures = c[5];
+        stats.distinctPixels = c[6];
+        return stats;
+    }
+
+    /**
+     * Size of hit mask buffer for image of given number of pixels, in 32-bit words.
+     */
+    static constexpr size_t hitMaskWords(size_t numPixels) noexcept {
+        return (numPixels + 31) / 32;
+    }
+
+};
+
+#endif //FRACTALEXPLORER_RENDERSTATISTICS_HPP
@@ -0,0 +1,166 @@
+#include "RenderWorker.hpp"
+
+#include "DeviceMemoryBudget.hpp"
+#include "Metrics.hpp"
+#include "Tracer.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+
+LOGGER()
+
+RenderWorker::RenderWorker(ImageEnginePtr engine, size_t width, size_t height, FrameCallback onFrame,
+                           ProgressCallback onProgress)
+    : engine_(std::move(engine)),
+      width_(width),
+      height_(height),
+      onFrame_(std::move(onFrame)),
+      onProgress_(std::move(onProgress)),
+      state_(std::make_shared<State>())
+{
+    thread_ = std::thread { &RenderWorker::run, this };
+}
+
+RenderWorker::~RenderWorker() {
+    {
+        std::lock_guard lock { state_->mutex };
+        state_->stopping = true;
+        if (state_->inFlight) {
+            state_->inFlight->cancel();
+        }
+    }
+    state_->changed.notify_all();
+    thread_.join();
+}
+
+void RenderWorker::request(KernelArgs args) {
+    static auto& framesSuperseded = Metrics::instance().counter("frames.superseded");
+    static auto& framesCancelled = Metrics::instance().counter("frames.cancelled");
+    {
+        std::lock_guard lock { state_->mutex };
+        if (state_->pending) {
+            framesSuperseded.add();
+        }
+        state_->pending = std::move(args);
+        if (state_->inFlight && !state_->inFlight->cancelled() && (state_->inFlightRefinement
+                || std::chrono::steady_clock::now() - state_->lastFrameAt < maxFrameGap)) {
+            state_->inFlight->cancel();
+            framesCancelled.add();
+        }
+    }
+    state_->changed.notify_all();
+}
+
+void RenderWorker::run() {
+    size_t pass = 0;
+    bool refining = false;
+    while (true) {
+        std::optional<KernelArgs> args;
+        auto cancellation = std::make_shared<CancellationToken>();
+        {
+            std::unique_lock lock { state_->mutex };
+            state_->changed.wait(lock, [this, &refining]() {
+                return state_->stopping || state_->pending || refining;
+            });
+            if (state_->stopping) {
+                return;
+            }
+            args = std::move(state_->pending);
+            state_->pending.reset();
+            state_->inFlight = cancellation;
+            state_->inFlightRefinement = !args;
+        }
+
+        pass = args ? 0 : pass + 1;
+        engine_->setSlicedDispatch(SlicedDispatch { sliceLatency, cancellation, onProgress_ });
+        refining = render(args, pass, *cancellation) && pass < maxRefinementPasses;
+
+        std::lock_guard lock { state_->mutex };
+        state_->inFlight.reset();
+    }
+}
+
+/**
+ * Buffers kept for reuse; one is held by presented frame and one is being filled in steady state.
+ */
+static constexpr size_t maxFreeBuffers = 2;
+
+bool RenderWorker::render(const std::optional<KernelArgs>& args, size_t pass,
+                          const CancellationToken& cancellation) {
+    TRACE_SCOPE("RenderWorker::render")
+    static auto& framesDropped = Metrics::instance().counter("frames.dropped");
+    auto computeStart = std::chrono::steady_clock::now();
+    try {
+        if (args) {
+            engine_->compute(*args);
+        } else if (!engine_->refine()) {
+            return false;
+        }
+        if (cancellation.cancelled()) {
+            // superseded; pending request is picked up next
+            return false;
+        }
+        auto computeEnd = std::chrono::steady_clock::now();
+
+        bool deliverPass = args || pass >= maxRefinementPasses;
+        if (!deliverPass) {
+            // refinement is not slowed down by copies nobody would see
+            std::lock_guard lock { state_->mutex };
+            deliverPass = state_->framesHeld == 0;
+        }
+        if (deliverPass) {
+            deliver(engine_->statistics(), computeEnd - computeStart, computeEnd, pass);
+        }
+    } catch (const DeviceMemoryExhausted& e) {
+        // previous frame stays on screen; next request will try again
+        logger->warn(fmt::format("Frame was not computed: {}", e.what()));
+        framesDropped.add();
+        return false;
+    } catch (const std::exception& e) {
+        logger->error(fmt::format("Frame was not computed: {}", e.what()));
+        framesDropped.add();
+        return false;
+    }
+    return true;
+}
+
+void RenderWorker::deliver(std::optional<RenderStatistics> statistics, std::chrono::nanoseconds computeTime,
+                           std::chrono::steady_clock::time_point readbackStart, size_t pass) {
+    std::vector<uint32_t> pixels;
+    {
+        std::lock_guard lock { state_->mutex };
+        if (!state_->freeBuffers.empty()) {
+            pixels = std::move(state_->freeBuffers.back());
+            state_->freeBuffers.pop_back();
+        }
+    }
+    pixels.resize(width_ * height_);
+
+    if (auto image = engine_->map()) {
+        // mapped rows may be padded; frame rows are tightly packed
+        for (size_t row = 0; row < height_; ++row) {
+            std::copy_n(image->pixels + row * image->rowLength, width_, pixels.data() + row * width_);
+        }
+        engine_->unmap();
+    } else {
+        engine_->read(pixels.data());
+    }
+    auto readbackEnd = std::chrono::steady_clock::now();
+
+    {
+        std::lock_guard lock { state_->mutex };
+        ++state_->framesHeld;
+        state_->lastFrameAt = readbackEnd;
+    }
+    auto* frame = new RenderedFrame {
+        std::move(pixels), width_, std::move(statistics), computeTime, readbackEnd - readbackStart, pass
+    };
+    onFrame_(RenderedFramePtr { frame, [state = state_](RenderedFrame* frame) {
+        std::lock_guard lock { state->mutex };
+        --state->framesHeld;
+        if (state->freeBuffers.size() < maxFreeBuffers) {
+            state->freeBuffers.push_back(std::move(frame->pixels));
+        }
+        delete frame;
+    }});
+}
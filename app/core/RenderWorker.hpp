@@ -0,0 +1,153 @@
+#ifndef FRACTALEXPLORER_RENDERWORKER_HPP
+#define FRACTALEXPLORER_RENDERWORKER_HPP
+
+#include "ImageEngine.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/**
+ * Frame computed by RenderWorker. Pixels are copied out of the engine, so worker goes on computing while frame is
+ * held; buffers of released frames are reused for later ones.
+ */
+struct RenderedFrame {
+    /**
+     * width * height RGBA8 values, rows tightly packed.
+     */
+    std::vector<uint32_t> pixels;
+    size_t width;
+    std::optional<RenderStatistics> statistics;
+    std::chrono::nanoseconds computeTime;
+    /**
+     * Read back (or map) and copy into pixels.
+     */
+    std::chrono::nanoseconds readbackTime;
+    /**
+     * 0 for the frame computed from requested args, number of refinement pass otherwise.
+     */
+    size_t pass;
+};
+
+using RenderedFramePtr = std::shared_ptr<const RenderedFrame>;
+
+/**
+ * Thread which owns an engine and computes frames for the latest requested args. Requests go to a single-slot
+ * mailbox: one that arrives before the previous is started replaces it, so a burst of requests (e.g. slider being
+ * dragged) results in a single frame rather than a backlog of stale ones. While no request is pending, last
+ * frame is refined (see ImageEngine::refine).
+ *
+ * Frames are computed in slices (see SlicedDispatch), so that a new request also cancels frame being computed.
+ * Refinement passes are always cancelled; frames of requested args only if a frame was delivered recently, so that
+ * continuous stream of requests still shows intermediate images.
+ *
+ * Worker never waits for frames to be presented, so hidden or not repainted widgets do not stall it. Intermediate
+ * refinement passes are only delivered if no delivered frame is held anymore; frames of requested args and the
+ * last refinement pass always are.
+ *
+ * Engine must not be used by anyone else while worker exists.
+ */
+class RenderWorker {
+
+public:
+
+    /**
+     * Called on worker thread for every computed frame.
+     */
+    using FrameCallback = std::function<void(RenderedFramePtr)>;
+
+    /**
+     * Called on worker thread with fraction of frame computed so far.
+     */
+    using ProgressCallback = std::function<void(double)>;
+
+    /**
+     * Target duration of a slice; cancellation takes effect within about a frame of 60 Hz display.
+     */
+    static constexpr std::chrono::milliseconds sliceLatency { 16 };
+
+    /**
+     * Frame being computed is only cancelled by new request if the last frame was delivered within this interval.
+     */
+    static constexpr std::chrono::milliseconds maxFrameGap { 250 };
+
+    /**
+     * Refinement stops after this many passes; log-scaled density barely changes by then.
+     */
+    static constexpr size_t maxRefinementPasses = 255;
+
+    /**
+     * Width and height must match image of engine.
+     */
+    RenderWorker(ImageEnginePtr engine, size_t width, size_t height, FrameCallback onFrame,
+                 ProgressCallback onProgress = {});
+
+    RenderWorker(const RenderWorker&) = delete;
+
+    RenderWorker& operator=(const RenderWorker&) = delete;
+
+    /**
+     * Abandons pending request and joins worker. Frames held elsewhere stay valid.
+     */
+    ~RenderWorker();
+
+    /**
+     * Compute frame for args, replacing request which has not been started yet.
+     */
+    void request(KernelArgs args);
+
+private:
+
+    /**
+     * Shared with released frames, which may outlive worker.
+     */
+    struct State {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::optional<KernelArgs> pending;
+        bool stopping = false;
+
+        /**
+         * Delivered frames which are not released yet, and buffers of released ones.
+         */
+        size_t framesHeld = 0;
+        std::vector<std::vector<uint32_t>> freeBuffers;
+
+        /**
+         * Cancellation of frame being computed, if any.
+         */
+        std::shared_ptr<CancellationToken> inFlight;
+        bool inFlightRefinement = false;
+        std::chrono::steady_clock::time_point lastFrameAt = std::chrono::steady_clock::now();
+    };
+
+    ImageEnginePtr engine_;
+    size_t width_, height_;
+    FrameCallback onFrame_;
+    ProgressCallback onProgress_;
+    std::shared_ptr<State> state_;
+
+    std::thread thread_;
+
+    void run();
+
+    /**
+     * Compute requested args, or refine last frame if args are empty. Returns false if nothing was computed or
+     * computation was cancelled.
+     */
+    bool render(const std::optional<KernelArgs>& args, size_t pass, const CancellationToken&);
+
+    /**
+     * Copy image of engine into a free buffer and hand it to onFrame_.
+     */
+    void deliver(std::optional<RenderStatistics>, std::chrono::nanoseconds computeTime,
+                 std::chrono::steady_clock::time_point readbackStart, size_t pass);
+
+};
+
+#endif //FRACTALEXPLORER_RENDERWORKER_HPP
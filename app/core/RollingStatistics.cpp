@@ -0,0 +1,39 @@
+#include "RollingStatistics.hpp"
+
+#include <algorithm>
+
+RollingStatistics::RollingStatistics(size_t windowSize) {
+    window_.reserve(windowSize);
+}
+
+void RollingStatistics::add(double sample) {
+    if (window_.size() < window_.capacity()) {
+        window_.push_back(sample);
+    } else {
+        window_[next_] = sample;
+        next_ = (next_ + 1) % window_.size();
+    }
+    ++count_;
+}
+
+RollingStatistics::Summary RollingStatistics::summary() const {
+    Summary summary;
+    summary.count = count_;
+    if (window_.empty()) {
+        return summary;
+    }
+
+    auto sorted = window_;
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](double p) {
+        return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+    };
+    for (auto sample : sorted) {
+        summary.mean += sample;
+    }
+    summary.mean /= sorted.size();
+    summary.p50 = percentile(0.50);
+    summary.p95 = percentile(0.95);
+    summary.p99 = percentile(0.99);
+    return summary;
+}
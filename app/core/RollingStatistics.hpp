@@ -0,0 +1,34 @@
+#ifndef FRACTALEXPLORER_ROLLINGSTATISTICS_HPP
+#define FRACTALEXPLORER_ROLLINGSTATISTICS_HPP
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Statistics over a sliding window of most recent samples.
+ */
+class RollingStatistics {
+
+    std::vector<double> window_;
+    size_t next_ = 0;
+    size_t count_ = 0;
+
+public:
+
+    struct Summary {
+        size_t count = 0;
+        double mean = 0, p50 = 0, p95 = 0, p99 = 0;
+    };
+
+    explicit RollingStatistics(size_t windowSize = 512);
+
+    void add(double sample);
+
+    /**
+     * count is the total number of samples ever added; the rest is computed over the window.
+     */
+    Summary summary() const;
+
+};
+
+#endif //FRACTALEXPLORER_ROLLINGSTATISTICS_HPP
@@ -0,0 +1,194 @@
+#ifndef FRACTALEXPLORER_SIMDPACK_HPP
+#define FRACTALEXPLORER_SIMDPACK_HPP
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+/**
+ * Fixed number of values operated on lane-wise. Plain portable C++: no intrinsics and no target flags, so every
+ * operation is a scalar loop with constant trip count, which the compiler may or may not vectorize for the
+ * baseline architecture. Transcendental functions (see map) are always evaluated lane by lane.
+ */
+template <typename T, size_t N>
+struct Pack {
+
+    using value_type = T;
+
+    static constexpr size_t size = N;
+
+    alignas(sizeof(T) * N >= 16 ? 16 : alignof(T)) std::array<T, N> v {};
+
+    Pack() = default;
+
+    /**
+     * Broadcast scalar to every lane.
+     */
+    Pack(T scalar) { v.fill(scalar); }
+
+    inline T& operator[](size_t i) noexcept { return v[i]; }
+
+    inline const T& operator[](size_t i) const noexcept { return v[i]; }
+
+    template <typename F>
+    static Pack generate(F&& f) {
+        Pack r;
+        for (size_t i = 0; i < N; ++i) r.v[i] = f(i);
+        return r;
+    }
+
+    template <typename U>
+    Pack<U, N> cast() const {
+        Pack<U, N> r;
+        for (size_t i = 0; i < N; ++i) r.v[i] = static_cast<U>(v[i]);
+        return r;
+    }
+};
+
+template <size_t N>
+using Mask = Pack<bool, N>;
+
+#define FRACTALEXPLORER_PACK_BINARY_OP(op) \
+    template <typename T, size_t N> \
+    inline Pack<T, N> operator op(const Pack<T, N>& a, const Pack<T, N>& b) { \
+        Pack<T, N> r; \
+        for (size_t i = 0; i < N; ++i) r.v[i] = a.v[i] op b.v[i]; \
+        return r; \
+    } \
+    template <typename T, size_t N> \
+    inline Pack<T, N> operator op(const Pack<T, N>& a, typename Pack<T, N>::value_type b) { \
+        return a op Pack<T, N>(b); \
+    } \
+    template <typename T, size_t N> \
+    inline Pack<T, N> operator op(typename Pack<T, N>::value_type a, const Pack<T, N>& b) { \
+        return Pack<T, N>(a) op b; \
+    } \
+    template <typename T, size_t N> \
+    inline Pack<T, N>& operator op##=(Pack<T, N>& a, const Pack<T, N>& b) { \
+        return a = a op b; \
+    }
+
+FRACTALEXPLORER_PACK_BINARY_OP(+)
+FRACTALEXPLORER_PACK_BINARY_OP(-)
+FRACTALEXPLORER_PACK_BINARY_OP(*)
+FRACTALEXPLORER_PACK_BINARY_OP(/)
+FRACTALEXPLORER_PACK_BINARY_OP(%)
+FRACTALEXPLORER_PACK_BINARY_OP(&)
+FRACTALEXPLORER_PACK_BINARY_OP(|)
+FRACTALEXPLORER_PACK_BINARY_OP(^)
+FRACTALEXPLORER_PACK_BINARY_OP(>>)
+FRACTALEXPLORER_PACK_BINARY_OP(<<)
+
+#undef FRACTALEXPLORER_PACK_BINARY_OP
+
+#define FRACTALEXPLORER_PACK_COMPARISON(op) \
+    template <typename T, size_t N> \
+    inline Mask<N> operator op(const Pack<T, N>& a, const Pack<T, N>& b) { \
+        Mask<N> r; \
+        for (size_t i = 0; i < N; ++i) r.v[i] = a.v[i] op b.v[i]; \
+        return r; \
+    } \
+    template <typename T, size_t N> \
+    inline Mask<N> operator op(const Pack<T, N>& a, typename Pack<T, N>::value_type b) { \
+        return a op Pack<T, N>(b); \
+    }
+
+FRACTALEXPLORER_PACK_COMPARISON(==)
+FRACTALEXPLORER_PACK_COMPARISON(!=)
+FRACTALEXPLORER_PACK_COMPARISON(<)
+FRACTALEXPLORER_PACK_COMPARISON(<=)
+FRACTALEXPLORER_PACK_COMPARISON(>)
+FRACTALEXPLORER_PACK_COMPARISON(>=)
+
+#undef FRACTALEXPLORER_PACK_COMPARISON
+
+template <typename T, size_t N>
+inline Pack<T, N> operator-(const Pack<T, N>& a) {
+    return Pack<T, N>::generate([&](size_t i) { return -a.v[i]; });
+}
+
+template <size_t N>
+inline Mask<N> operator!(const Mask<N>& a) {
+    return Mask<N>::generate([&](size_t i) { return !a.v[i]; });
+}
+
+template <size_t N>
+inline Mask<N> operator&&(const Mask<N>& a, const Mask<N>& b) {
+    return Mask<N>::generate([&](size_t i) { return a.v[i] && b.v[i]; });
+}
+
+template <size_t N>
+inline Mask<N> operator||(const Mask<N>& a, const Mask<N>& b) {
+    return Mask<N>::generate([&](size_t i) { return a.v[i] || b.v[i]; });
+}
+
+template <size_t N>
+inline bool any(const Mask<N>& m) {
+    bool r = false;
+    for (size_t i = 0; i < N; ++i) r |= m.v[i];
+    return r;
+}
+
+template <size_t N>
+inline size_t count(const Mask<N>& m) {
+    size_t r = 0;
+    for (size_t i = 0; i < N; ++i) r += m.v[i];
+    return r;
+}
+
+/**
+ * Lane-wise mask ? a : b.
+ */
+template <typename T, size_t N>
+inline Pack<T, N> select(const Mask<N>& mask, const Pack<T, N>& a, const Pack<T, N>& b) {
+    return Pack<T, N>::generate([&](size_t i) { return mask.v[i] ? a.v[i] : b.v[i]; });
+}
+
+/**
+ * Apply scalar function to every lane.
+ */
+template <typename F, typename T, size_t N, typename... Rest>
+inline auto map(F&& f, const Pack<T, N>& a, const Rest&... rest) {
+    using R = decltype(f(a.v[0], rest.v[0]...));
+    return Pack<R, N>::generate([&](size_t i) { return f(a.v[i], rest.v[i]...); });
+}
+
+template <typename T, size_t N>
+inline Pack<T, N> sqrt(const Pack<T, N>& a) {
+    return map([](T x) { return std::sqrt(x); }, a);
+}
+
+template <typename T, size_t N>
+inline Pack<T, N> abs(const Pack<T, N>& a) {
+    return map([](T x) { return std::abs(x); }, a);
+}
+
+template <typename T, size_t N>
+inline Pack<T, N> cbrt(const Pack<T, N>& a) {
+    return map([](T x) { return std::cbrt(x); }, a);
+}
+
+template <typename T, size_t N>
+inline Pack<T, N> atan2(const Pack<T, N>& y, const Pack<T, N>& x) {
+    return map([](T y, T x) { return std::atan2(y, x); }, y, x);
+}
+
+template <typename T, size_t N>
+inline Pack<T, N> sin(const Pack<T, N>& a) {
+    return map([](T x) { return std::sin(x); }, a);
+}
+
+template <typename T, size_t N>
+inline Pack<T, N> cos(const Pack<T, N>& a) {
+    return map([](T x) { return std::cos(x); }, a);
+}
+
+/**
+ * OpenCL sign(): 1 for positive, -1 for negative, x itself for zeros and NaN.
+ */
+template <typename T, size_t N>
+inline Pack<T, N> sign(const Pack<T, N>& a) {
+    return map([](T x) { return x > 0 ? T(1) : x < 0 ? T(-1) : x; }, a);
+}
+
+#endif //FRACTALEXPLORER_SIMDPACK_HPP
@@ -0,0 +1,34 @@
+#include "SlicedDispatch.hpp"
+
+#include <algorithm>
+
+/**
+ * Before anything is measured, image is split into this many slices.
+ */
+static constexpr size_t initialSlices = 8;
+
+/**
+ * Weight of the latest measurement in throughput estimate.
+ */
+static constexpr double throughputSmoothing = 0.3;
+
+size_t SliceSizer::nextSlice(std::chrono::nanoseconds latency, size_t remaining, size_t totalRows,
+                             size_t granularity) const {
+    granularity = std::max<size_t>(granularity, 1);
+    auto rows = rowsPerSecond_ > 0.0
+        ? static_cast<size_t>(rowsPerSecond_ * std::chrono::duration<double>(latency).count())
+        : totalRows / initialSlices;
+    rows = std::max(rows / granularity * granularity, granularity);
+    return std::min(rows, remaining);
+}
+
+void SliceSizer::measured(size_t rows, std::chrono::nanoseconds duration) {
+    auto seconds = std::chrono::duration<double>(duration).count();
+    if (rows == 0 || seconds <= 0.0) {
+        return;
+    }
+    auto sample = static_cast<double>(rows) / seconds;
+    rowsPerSecond_ = rowsPerSecond_ > 0.0
+        ? rowsPerSecond_ + throughputSmoothing * (sample - rowsPerSecond_)
+        : sample;
+}
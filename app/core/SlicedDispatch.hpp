@@ -0,0 +1,72 @@
+#ifndef FRACTALEXPLORER_SLICEDDISPATCH_HPP
+#define FRACTALEXPLORER_SLICEDDISPATCH_HPP
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+
+/**
+ * Flag by which a running computation is asked to stop. Computations check it between slices of work, so they stop
+ * within a slice after cancel().
+ */
+class CancellationToken {
+
+    std::atomic<bool> cancelled_ { false };
+
+public:
+
+    inline void cancel() noexcept { cancelled_.store(true, std::memory_order_relaxed); }
+
+    inline bool cancelled() const noexcept { return cancelled_.load(std::memory_order_relaxed); }
+
+};
+
+/**
+ * Computation of an image in slices (bands of rows), each dispatched once the previous one has finished, so that
+ * computation can be observed and abandoned between them.
+ */
+struct SlicedDispatch {
+
+    /**
+     * Target duration of a slice. Size of slices is adapted to measured throughput to meet it.
+     */
+    std::chrono::nanoseconds sliceLatency = std::chrono::milliseconds(16);
+
+    /**
+     * Checked before every slice; may be null.
+     */
+    std::shared_ptr<const CancellationToken> cancellation;
+
+    /**
+     * Called after every slice with fraction of image computed so far; may be empty.
+     */
+    std::function<void(double)> progress;
+
+    inline bool cancelled() const noexcept { return cancellation && cancellation->cancelled(); }
+
+};
+
+/**
+ * Chooses number of rows per slice from throughput of previous slices. Throughput is smoothed and carried over to
+ * subsequent images, so the first slice of an image is already sized right unless args change its cost a lot.
+ */
+class SliceSizer {
+
+    /**
+     * Zero until the first slice is measured.
+     */
+    double rowsPerSecond_ = 0.0;
+
+public:
+
+    /**
+     * Rows of the next slice: a multiple of granularity (but at least granularity), and not more than remaining.
+     */
+    size_t nextSlice(std::chrono::nanoseconds latency, size_t remaining, size_t totalRows, size_t granularity) const;
+
+    void measured(size_t rows, std::chrono::nanoseconds duration);
+
+};
+
+#endif //FRACTALEXPLORER_SLICEDDISPATCH_HPP
@@ -0,0 +1,99 @@
+// SYCL goes first: cl.hpp declares cl::size_t template, which would shadow size_t inside namespace cl::sycl
+#include <CL/sycl.hpp>
+
+#include "SyclNewtonFractal.hpp"
+
+#include "Tracer.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+LOGGER()
+
+/**
+ * Work-item computes a pack of columns in lockstep, like the native engine does.
+ */
+static constexpr size_t lanes = 4;
+
+class NewtonFractalSyclKernel;
+
+struct SyclNewtonFractalEngine::Queue {
+    cl::sycl::queue queue {
+        [](cl::sycl::exception_list errors) {
+            for (const auto& error : errors) {
+                try {
+                    std::rethrow_exception(error);
+                } catch (const cl::sycl::exception& e) {
+                    logger->error(fmt::format("Asynchronous SYCL error: {}", e.what()));
+                }
+            }
+        }
+    };
+};
+
+SyclNewtonFractalEngine::SyclNewtonFractalEngine(size_t width, size_t height)
+    : queue_(std::make_unique<Queue>())
+{
+    logger->info(fmt::format(
+        "SYCL engine uses device {}",
+        queue_->queue.get_device().get_info<cl::sycl::info::device::name>()
+    ));
+    resize(width, height);
+}
+
+SyclNewtonFractalEngine::~SyclNewtonFractalEngine() = default;
+
+void SyclNewtonFractalEngine::resize(size_t width, size_t height) {
+    if (width == width_ && height == height_) {
+        return;
+    }
+    width_ = width;
+    height_ = height;
+    hitMask_.assign(RenderStatistics::hitMaskWords(width * height), 0);
+    pixels_.assign(width * height, newtonFractalBackgroundPixel);
+    statistics_.reset();
+}
+
+void SyclNewtonFractalEngine::compute(const KernelArgs& args) {
+    TRACE_SCOPE("SyclNewtonFractalEngine::compute")
+    auto params = NewtonFractalParams::fromArgs(args);
+    std::fill(hitMask_.begin(), hitMask_.end(), 0);
+
+    // as in native engine, every column is computed once instead of height times, see NativeNewtonFractal.cpp
+    size_t packs = (width_ + lanes - 1) / lanes;
+    std::vector<NewtonFractalCounters> packCounters(packs);
+    {
+        cl::sycl::buffer<uint32_t, 1> hitMask { hitMask_.data(), cl::sycl::range<1> { hitMask_.size() } };
+        cl::sycl::buffer<NewtonFractalCounters, 1> counters { packCounters.data(), cl::sycl::range<1> { packs } };
+
+        queue_->queue.submit([&](cl::sycl::handler& cgh) {
+            auto mask = hitMask.get_access<cl::sycl::access::mode::atomic>(cgh);
+            auto out = counters.get_access<cl::sycl::access::mode::discard_write>(cgh);
+            size_t width = width_, height = height_;
+
+            cgh.parallel_for<NewtonFractalSyclKernel>(cl::sycl::range<1> { packs }, [=](cl::sycl::id<1> pack) {
+                NewtonFractalCounters workItemCounters;
+                NewtonFractalLanes<lanes>::compute(
+                    params, pack[0] * lanes, width, height,
+                    [&](size_t pixel) { mask[pixel >> 5].fetch_or(1u << (pixel & 31)); },
+                    workItemCounters
+                );
+                out[pack] = workItemCounters;
+            });
+        });
+        queue_->queue.wait_and_throw();
+        // buffers copy results back into host vectors when destroyed
+    }
+
+    NewtonFractalCounters total;
+    for (const auto& c : packCounters) {
+        total += c;
+    }
+    auto distinctPixels = composeNewtonFractalImage(hitMask_.data(), pixels_.size(), pixels_.data());
+    statistics_ = total.statistics(height_, distinctPixels);
+}
+
+void SyclNewtonFractalEngine::read(uint32_t* pixels) {
+    std::memcpy(pixels, pixels_.data(), pixels_.size() * sizeof(uint32_t));
+}
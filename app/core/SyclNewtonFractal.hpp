@@ -0,0 +1,54 @@
+#ifndef FRACTALEXPLORER_SYCLNEWTONFRACTAL_HPP
+#define FRACTALEXPLORER_SYCLNEWTONFRACTAL_HPP
+
+#include "ImageEngine.hpp"
+#include "NewtonFractalHost.hpp"
+
+#include <memory>
+#include <vector>
+
+/**
+ * newton_fractal as a SYCL kernel, run on default device of triSYCL (host device, work-items on OpenMP threads).
+ * Only built with FRACTALEXPLORER_WITH_SYCL.
+ */
+class SyclNewtonFractalEngine : public ImageEngine {
+
+    /**
+     * SYCL queue. Kept out of header, so that SYCL headers are only included by the engine itself.
+     */
+    struct Queue;
+    std::unique_ptr<Queue> queue_;
+
+    size_t width_ = 0, height_ = 0;
+    std::vector<uint32_t> hitMask_;
+    std::vector<uint32_t> pixels_;
+    std::optional<RenderStatistics> statistics_;
+
+public:
+
+    SyclNewtonFractalEngine(size_t width, size_t height);
+
+    ~SyclNewtonFractalEngine() override;
+
+    std::string name() const override { return "sycl"; }
+
+    bool ready() override { return true; }
+
+    ArgsTypesWithNames argTypes() override { return newtonFractalSignature(); }
+
+    void resize(size_t width, size_t height) override;
+
+    void compute(const KernelArgs&) override;
+
+    void read(uint32_t* pixels) override;
+
+    /**
+     * Image is computed in host memory, so it is handed out in place.
+     */
+    std::optional<MappedImage> map() override { return MappedImage { pixels_.data(), width_ }; }
+
+    std::optional<RenderStatistics> statistics() override { return statistics_; }
+
+};
+
+#endif //FRACTALEXPLORER_SYCLNEWTONFRACTAL_HPP
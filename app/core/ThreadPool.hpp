@@ -0,0 +1,58 @@
+#ifndef FRACTALEXPLORER_THREADPOOL_HPP
+#define FRACTALEXPLORER_THREADPOOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Fixed-size pool of worker threads executing tasks in FIFO order.
+ */
+class ThreadPool {
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable hasTasks_;
+    bool stopping_ = false;
+
+    void enqueue(std::function<void()>);
+
+    void workerLoop();
+
+public:
+
+    explicit ThreadPool(size_t numThreads);
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Finishes all queued tasks and joins workers.
+     */
+    ~ThreadPool();
+
+    inline size_t size() const noexcept { return workers_.size(); }
+
+    /**
+     * Schedule task for execution. Result (or exception) of the task is delivered through returned future.
+     */
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& f) {
+        using Result = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+        auto future = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return future;
+    }
+
+};
+
+#endif //FRACTALEXPLORER_THREADPOOL_HPP
@@ -0,0 +1,98 @@
+#include "Tracer.hpp"
+
+#include "Utility.hpp"
+
+#include <fstream>
+
+LOGGER()
+
+static constexpr size_t maxEvents = 1u << 20;
+
+static constexpr uint32_t hostPid = 0;
+static constexpr uint32_t devicePid = 1;
+
+std::atomic<bool> Tracer::enabled_ { false };
+
+/**
+ * Small sequential id of calling thread, for readable trace lanes.
+ */
+static uint32_t currentThreadId() {
+    static std::atomic<uint32_t> counter { 0 };
+    thread_local uint32_t id = counter++;
+    return id;
+}
+
+static void writeEscaped(std::ostream& out, const std::string& str) {
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << ' ';
+        } else {
+            out << c;
+        }
+    }
+}
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+int64_t Tracer::micros(Clock::time_point time) const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time - origin_).count();
+}
+
+void Tracer::start() {
+    {
+        std::lock_guard lock { mutex_ };
+        events_.clear();
+        origin_ = Clock::now();
+    }
+    enabled_.store(true);
+    logger->info("Tracing started");
+}
+
+void Tracer::add(Event event) {
+    std::lock_guard lock { mutex_ };
+    if (events_.size() < maxEvents) {
+        events_.push_back(std::move(event));
+    }
+}
+
+void Tracer::hostSpan(const char* name, Clock::time_point start, Clock::time_point end) {
+    add({ name, "host", micros(start), micros(end) - micros(start), hostPid, currentThreadId() });
+}
+
+void Tracer::deviceSpan(std::string name, const char* category, Clock::time_point start, Clock::time_point end) {
+    add({ std::move(name), category, micros(start), micros(end) - micros(start), devicePid, 0 });
+}
+
+bool Tracer::stop(const std::filesystem::path& file) {
+    enabled_.store(false);
+
+    std::vector<Event> events;
+    {
+        std::lock_guard lock { mutex_ };
+        events.swap(events_);
+    }
+
+    std::ofstream out { file, std::ios::trunc };
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << R"({"ph":"M","name":"process_name","pid":0,"tid":0,"args":{"name":"host"}},)" "\n";
+    out << R"({"ph":"M","name":"process_name","pid":1,"tid":0,"args":{"name":"OpenCL device"}})";
+    for (const auto& event : events) {
+        out << ",\n{\"ph\":\"X\",\"name\":\"";
+        writeEscaped(out, event.name);
+        out << "\",\"cat\":\"" << event.category << "\",\"ts\":" << event.startMicros
+            << ",\"dur\":" << event.durationMicros << ",\"pid\":" << event.pid << ",\"tid\":" << event.tid << '}';
+    }
+    out << "\n]}\n";
+
+    if (!out) {
+        logger->warn(fmt::format("Failed to write trace to {}", file.string()));
+        return false;
+    }
+    logger->info(fmt::format("Trace of {} events written to {}", events.size(), file.string()));
+    return true;
+}
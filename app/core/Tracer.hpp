@@ -0,0 +1,99 @@
+#ifndef FRACTALEXPLORER_TRACER_HPP
+#define FRACTALEXPLORER_TRACER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Records host spans and device commands on a single timeline and writes them as Chrome trace_event JSON
+ * (viewable in chrome://tracing or Perfetto).
+ *
+ * Disabled by default; when disabled, TRACE_SCOPE costs a single relaxed atomic load.
+ */
+class Tracer {
+
+public:
+
+    using Clock = std::chrono::steady_clock;
+
+    static Tracer& instance();
+
+    static inline bool enabled() noexcept { return enabled_.load(std::memory_order_relaxed); }
+
+    /**
+     * Drop previously recorded events and start recording.
+     */
+    void start();
+
+    /**
+     * Stop recording and write recorded events to given file. Returns false if file could not be written.
+     */
+    bool stop(const std::filesystem::path&);
+
+    void hostSpan(const char* name, Clock::time_point start, Clock::time_point end);
+
+    /**
+     * Device command, already converted to host time.
+     */
+    void deviceSpan(std::string name, const char* category, Clock::time_point start, Clock::time_point end);
+
+private:
+
+    struct Event {
+        std::string name;
+        const char* category;
+        int64_t startMicros, durationMicros;
+        uint32_t pid, tid;
+    };
+
+    static std::atomic<bool> enabled_;
+
+    Clock::time_point origin_ = Clock::now();
+
+    std::vector<Event> events_;
+
+    std::mutex mutex_;
+
+    void add(Event);
+
+    int64_t micros(Clock::time_point) const;
+
+};
+
+/**
+ * Records a host span from construction to destruction, if tracing was enabled at construction.
+ */
+class TraceScope {
+
+    const char* name_;
+    Tracer::Clock::time_point start_;
+    bool enabled_;
+
+public:
+
+    explicit TraceScope(const char* name) noexcept : name_(name), enabled_(Tracer::enabled()) {
+        if (enabled_) {
+            start_ = Tracer::Clock::now();
+        }
+    }
+
+    ~TraceScope() {
+        if (enabled_) {
+            Tracer::instance().hostSpan(name_, start_, Tracer::Clock::now());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+};
+
+#define _TRACE_CONCAT(a, b) a##b
+#define _TRACE_SCOPE_VAR(line) _TRACE_CONCAT(_traceScope, line)
+#define TRACE_SCOPE(name) TraceScope _TRACE_SCOPE_VAR(__LINE__) { name };
+
+#endif //FRACTALEXPLORER_TRACER_HPP
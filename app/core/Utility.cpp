@@ -1,13 +1,60 @@
 #include "Utility.hpp"
 
+#include <cstdlib>
+#include <mutex>
+
 static constexpr const char* logPattern = "%T.%e %n %t [%l] %^%v%$";
 
+static constexpr size_t logQueueSize = 8192;
+
+static spdlog::level::level_enum logLevel() {
+    if (const char* level = std::getenv("FRACTALEXPLORER_LOG_LEVEL"); level && *level) {
+        return spdlog::level::from_str(level);
+    }
+    return spdlog::level::info;
+}
+
 std::shared_ptr<spdlog::logger> getOrCreateLogger(const char* name) {
     if (spdlog::get(name)) {
         return spdlog::get(name);
     }
 
-    auto log = spdlog::stdout_color_mt(name);
+    static std::once_flag threadPoolCreated;
+    std::call_once(threadPoolCreated, []() {
+        spdlog::init_thread_pool(logQueueSize, 1);
+        spdlog::flush_every(std::chrono::seconds(1));
+    });
+
+    auto log = spdlog::create_async_nb<spdlog::sinks::stdout_color_sink_mt>(name);
     log->set_pattern(logPattern);
+    log->set_level(logLevel());
     return log;
 }
+
+std::filesystem::path cacheDirectory() {
+    if (const char* overridden = std::getenv("FRACTALEXPLORER_CACHE_DIR"); overridden && *overridden) {
+        return overridden;
+    }
+#ifdef _WIN32
+    if (const char* localAppData = std::getenv("LOCALAPPDATA"); localAppData && *localAppData) {
+        return std::filesystem::path(localAppData) / "FractalExplorer";
+    }
+#else
+    if (const char* xdgCache = std::getenv("XDG_CACHE_HOME"); xdgCache && *xdgCache) {
+        return std::filesystem::path(xdgCache) / "fractalexplorer";
+    }
+    if (const char* home = std::getenv("HOME"); home && *home) {
+        return std::filesystem::path(home) / ".cache" / "fractalexplorer";
+    }
+#endif
+    return std::filesystem::temp_directory_path() / "fractalexplorer";
+}
+
+uint64_t contentHash(std::string_view data, uint64_t seed) {
+    uint64_t hash = seed;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
@@ -2,16 +2,34 @@
 #define FRACTALEXPLORER_UTILITY_HPP
 
 #include <spdlog/spdlog.h>
+#include <spdlog/async.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <fmt/format.h>
 #include <string>
 #include <sstream>
+#include <string_view>
+#include <filesystem>
 
+#include <absl/strings/ascii.h>
 #include <absl/strings/str_join.h>
 #include <absl/strings/strip.h>
 
+/**
+ * Loggers are asynchronous: messages are written by a background thread, and dropped (oldest first) rather than
+ * blocking the caller when it falls behind. Runtime level can be set with FRACTALEXPLORER_LOG_LEVEL.
+ */
 std::shared_ptr<spdlog::logger> getOrCreateLogger(const char *name);
 
+/**
+ * Directory where persistent application caches are stored. Can be overridden with FRACTALEXPLORER_CACHE_DIR.
+ */
+std::filesystem::path cacheDirectory();
+
+/**
+ * Stable (across runs and platforms) 64-bit FNV-1a hash of given data.
+ */
+uint64_t contentHash(std::string_view data, uint64_t seed = 14695981039346656037ull);
+
 #define _STRINGIFY(x) #x
 #define STRINGIFY(x) _STRINGIFY(x)
 
@@ -19,4 +37,11 @@ std::shared_ptr<spdlog::logger> getOrCreateLogger(const char *name);
 
 #define LOC "[" __FUNCTION__ ":" STRINGIFY(__LINE__) "]"
 
+/**
+ * Logging for hot paths. Compiled out entirely below SPDLOG_ACTIVE_LEVEL (INFO in release builds), including
+ * evaluation of arguments. Format string and arguments are passed as to fmt::format.
+ */
+#define LOG_TRACE(...) SPDLOG_LOGGER_TRACE(logger, __VA_ARGS__)
+#define LOG_DEBUG(...) SPDLOG_LOGGER_DEBUG(logger, __VA_ARGS__)
+
 #endif //FRACTALEXPLORER_UTILITY_HPP
@@ -0,0 +1,117 @@
+#include "WorkStealingPool.hpp"
+
+#include <algorithm>
+#include <exception>
+
+WorkStealingPool::WorkStealingPool(size_t numThreads) {
+    numThreads = std::max<size_t>(numThreads, 1);
+    queues_.reserve(numThreads);
+    for (size_t i = 0; i < numThreads; ++i) {
+        queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+    workers_.reserve(numThreads);
+    for (size_t i = 0; i < numThreads; ++i) {
+        workers_.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard lock { sleepMutex_ };
+        stopping_ = true;
+    }
+    hasTasks_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+bool WorkStealingPool::tryPop(size_t worker, std::function<void()>& task) {
+    {
+        auto& own = *queues_[worker];
+        std::lock_guard lock { own.mutex };
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            --pending_;
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues_.size(); ++i) {
+        auto& victim = *queues_[(worker + i) % queues_.size()];
+        std::lock_guard lock { victim.mutex };
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            --pending_;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(size_t worker) {
+    while (true) {
+        std::function<void()> task;
+        if (tryPop(worker, task)) {
+            task();
+            continue;
+        }
+        std::unique_lock lock { sleepMutex_ };
+        hasTasks_.wait(lock, [this]() { return stopping_ || pending_ > 0; });
+        if (stopping_ && pending_ == 0) {
+            return;
+        }
+    }
+}
+
+void WorkStealingPool::parallelFor(size_t count, size_t chunkSize, const std::function<void(size_t, size_t)>& body) {
+    chunkSize = std::max<size_t>(chunkSize, 1);
+    auto numChunks = (count + chunkSize - 1) / chunkSize;
+    if (numChunks == 0) {
+        return;
+    }
+
+    struct Completion {
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t remaining;
+        std::exception_ptr error;
+    } completion;
+    completion.remaining = numChunks;
+
+    // counted before tasks become visible, so that a worker never takes more tasks than were counted
+    {
+        std::lock_guard lock { sleepMutex_ };
+        pending_ += numChunks;
+    }
+    // every worker starts with a contiguous share of chunks
+    for (size_t chunk = 0; chunk < numChunks; ++chunk) {
+        auto begin = chunk * chunkSize;
+        auto end = std::min(begin + chunkSize, count);
+        auto& queue = *queues_[chunk * queues_.size() / numChunks];
+        std::lock_guard lock { queue.mutex };
+        queue.tasks.emplace_back([&body, &completion, begin, end]() {
+            std::exception_ptr error;
+            try {
+                body(begin, end);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            std::lock_guard lock { completion.mutex };
+            if (error && !completion.error) {
+                completion.error = error;
+            }
+            if (--completion.remaining == 0) {
+                completion.done.notify_all();
+            }
+        });
+    }
+    hasTasks_.notify_all();
+
+    std::unique_lock lock { completion.mutex };
+    completion.done.wait(lock, [&completion]() { return completion.remaining == 0; });
+    if (completion.error) {
+        std::rethrow_exception(completion.error);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef FRACTALEXPLORER_WORKSTEALINGPOOL_HPP
+#define FRACTALEXPLORER_WORKSTEALINGPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Pool of worker threads, each with its own task deque. A worker takes tasks from the front of its deque and,
+ * once it is empty, steals from the back of the others, so that tasks of uneven cost keep every thread busy.
+ */
+class WorkStealingPool {
+
+    struct WorkerQueue {
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> workers_;
+
+    /**
+     * Number of queued tasks. Increased under sleepMutex_, so that wake-ups are not lost.
+     */
+    std::atomic<size_t> pending_ {0};
+    std::mutex sleepMutex_;
+    std::condition_variable hasTasks_;
+    bool stopping_ = false;
+
+    bool tryPop(size_t worker, std::function<void()>& task);
+
+    void workerLoop(size_t worker);
+
+public:
+
+    explicit WorkStealingPool(size_t numThreads = std::thread::hardware_concurrency());
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /**
+     * Finishes all queued tasks and joins workers.
+     */
+    ~WorkStealingPool();
+
+    inline size_t size() const noexcept { return workers_.size(); }
+
+    /**
+     * Call body(begin, end) for consecutive chunks of [0, count) of at most chunkSize elements, and wait until
+     * every chunk is processed. Exception thrown by body is rethrown after all chunks are finished.
+     */
+    void parallelFor(size_t count, size_t chunkSize, const std::function<void(size_t, size_t)>& body);
+
+};
+
+#endif //FRACTALEXPLORER_WORKSTEALINGPOOL_HPP
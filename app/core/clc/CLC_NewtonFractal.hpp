@@ -96,7 +96,49 @@ static constexpr std::string_view NEWTON_FRACTAL_SOURCE { R"CL(
     #define to_uint(x) as_uint(x)
 #endif
 
-#define DYNAMIC_COLOR 0
+#ifndef DYNAMIC_COLOR
+    #define DYNAMIC_COLOR 0
+#endif
+
+// arguments baked in by specialized variants (see KernelBase::specializableArgs);
+// branches on them are resolved at compile time then
+#ifdef SPECIALIZED_BACKWARD
+    #define BACKWARD_VALUE SPECIALIZED_BACKWARD
+#else
+    #define BACKWARD_VALUE backward
+#endif
+
+#ifdef SPECIALIZED_T
+    #define T_VALUE SPECIALIZED_T
+#else
+    #define T_VALUE t
+#endif
+
+#ifdef SPECIALIZED_RUNS_COUNT
+    #define RUNS_COUNT_VALUE SPECIALIZED_RUNS_COUNT
+#else
+    #define RUNS_COUNT_VALUE runs_count
+#endif
+
+// layout of statistics block; see RenderStatistics.hpp
+#define STAT_POINTS_GENERATED   0 // 64-bit, low word first
+#define STAT_POINTS_IN_VIEWPORT 2 // 64-bit, low word first
+#define STAT_FROZEN             4
+#define STAT_SOLVER_FAILURES    5
+#define STAT_DISTINCT_PIXELS    6
+
+// add value to 64-bit counter stored as two words, low word first
+void add_wide_counter(volatile global uint* counter, uint value) {
+    if (value != 0 && atomic_add(counter, value) > UINT_MAX - value) {
+        atomic_inc(counter + 1);
+    }
+}
+
+void add_counter(volatile global uint* counter, uint value) {
+    if (value != 0) {
+        atomic_add(counter, value);
+    }
+}
 
 float3 hsv2rgb(float3 hsv) {
     const float c = hsv.y * hsv.z;
@@ -135,7 +177,17 @@ kernel void newton_fractal(
     // color. this color will only be used as static!
     float3 color_in,
     // image buffer for output
-    write_only image2d_t image)
+    write_only image2d_t image,
+    // statistics block, see STAT_* definitions. accumulated, so must be zeroed by host
+    global uint* stats,
+    // bit per pixel, set when pixel is hit. must be zeroed by host
+    global uint* hit_mask
+#ifdef ACCUMULATE
+    // hits per pixel, added to by successive launches instead of drawing into image; the word after the last pixel
+    // holds maximum over all pixels. zeroed by host when image is cleared. see tone_map
+    , global uint* density
+#endif
+    )
 {
     // color
     #if (DYNAMIC_COLOR)
@@ -158,12 +210,17 @@ kernel void newton_fractal(
     // for each run
     real2 roots[3];
     real2 a;
-    const real2 c = -C * h * t / (3 - t * h); // t sign switches between Explicit and Implicit Euler method
-    const real a_modifier = -3 / (3 - t * h);
+    const real2 c = -C * h * T_VALUE / (3 - T_VALUE * h); // t sign switches between Explicit and Implicit Euler method
+    const real a_modifier = -3 / (3 - T_VALUE * h);
     const real max_distance_from_prev = length((real2)(max_x - min_x, max_y - min_y));
     real total_distance = 0.0;
+    // counted privately and flushed to stats once per work-item
+    uint points_generated = 0, points_in_viewport = 0, frozen_count = 0, solver_failures = 0, distinct_pixels = 0;
+    #ifdef ACCUMULATE
+        uint max_density = 0;
+    #endif
     // TODO run count was proved to be inefficient. remove?
-    for (int run = 0; run < runs_count; ++run) {
+    for (int run = 0; run < RUNS_COUNT_VALUE; ++run) {
         // choose starting point
         real2 starting_point = {
             ((random(&rng_state)) * span_x + min_x) / 2,
@@ -176,9 +233,13 @@ kernel void newton_fractal(
         for (int i = 0; i < points_count; ++i) {
             // compute next point:
             uint root_number = (to_uint(random(&rng_state)) >> 7) % 3;
-            if (backward) {
+            if (BACKWARD_VALUE) {
                 a = starting_point * a_modifier;
-                solve_cubic_newton_fractal_optimized(a, c, 1e-8, root_number, roots);
+                if (solve_cubic_newton_fractal_optimized(a, c, 1e-8, root_number, roots)) {
+                    // root is undefined, trajectory cannot be continued
+                    ++solver_failures;
+                    break;
+                }
 
                 real distance_from_prev = length(starting_point - roots[root_number]);
                 total_distance += distance_from_prev;
@@ -195,6 +256,7 @@ kernel void newton_fractal(
 
                 starting_point = a - h / 3.0 * a - h*last_mul_C / 3.0;
             }
+            ++points_generated;
             // the first iter_skip points will  be skipped
             if (is == 0) {
                 // transform coords:
@@ -204,7 +266,7 @@ kernel void newton_fractal(
                 // draw next point:
                 #if (DYNAMIC_COLOR)
                     //(1 - distance_from_prev / max_distance_from_prev)
-                    if (backward) {
+                    if (BACKWARD_VALUE) {
                         color_hsv.x = convert_float(360.0 * (root_number / 3.0));
                     } else {
                         color_hsv.x = convert_float(360.0 * sin(total_distance));
@@ -213,7 +275,16 @@ kernel void newton_fractal(
                     color_hsv.z = convert_float(1.0 * (total_distance / (max_distance_from_prev * (points_count - iter_skip))));
                 #endif
                 if (coord.x < image_width && coord.y < image_height && coord.x >= 0 && coord.y >= 0) {
-                    #if DYNAMIC_COLOR
+                    ++points_in_viewport;
+                    uint pixel = coord.y * image_width + coord.x;
+                    uint bit = 1u << (pixel & 31);
+                    // plain read first: most hits land on pixels which are already marked
+                    if (!(hit_mask[pixel >> 5] & bit) && !(atomic_or(hit_mask + (pixel >> 5), bit) & bit)) {
+                        ++distinct_pixels;
+                    }
+                    #if defined(ACCUMULATE)
+                        max_density = max(max_density, atomic_inc(density + pixel) + 1);
+                    #elif DYNAMIC_COLOR
                         write_imagef(image, coord, (float4)(hsv2rgb( color_hsv ), 1.0));
                     #else
                         write_imagef(image, coord, color);
@@ -222,7 +293,7 @@ kernel void newton_fractal(
                 } else {
                     if (++frozen > 15) {
                         // this generally means that solution is going to approach infinity
-                        //printf("[OCL] error at slave %d: frozen!\n", get_global_id(0));
+                        ++frozen_count;
                         break;
                     }
                 }
@@ -231,6 +302,17 @@ kernel void newton_fractal(
             }
         }
     }
+
+    add_wide_counter(stats + STAT_POINTS_GENERATED, points_generated);
+    add_wide_counter(stats + STAT_POINTS_IN_VIEWPORT, points_in_viewport);
+    add_counter(stats + STAT_FROZEN, frozen_count);
+    add_counter(stats + STAT_SOLVER_FAILURES, solver_failures);
+    add_counter(stats + STAT_DISTINCT_PIXELS, distinct_pixels);
+    #ifdef ACCUMULATE
+        if (max_density != 0) {
+            atomic_max(density + image_width * image_height, max_density);
+        }
+    #endif
 }
 
 )CL" };
@@ -3,6 +3,7 @@
 #include "app/core/clc/CLC_Definitions.hpp"
 #include "app/core/clc/CLC_Random.hpp"
 #include "app/core/clc/CLC_NewtonFractal.hpp"
+#include "app/core/clc/CLC_ToneMap.hpp"
 
 void SourcesRegistry::registerSources(std::string id, cl::Program::Sources&& src) {
     auto res = registry_.try_emplace(id, std::forward<cl::Program::Sources>(src));
@@ -39,4 +40,10 @@ SourcesRegistry::SourcesRegistry() {
             NEWTON_FRACTAL_SOURCE.data(), NEWTON_FRACTAL_SOURCE.size()
         }
     });
+
+    registerSources("tone-map", {
+        {
+            TONE_MAP_SOURCE.data(), TONE_MAP_SOURCE.size()
+        }
+    });
 }
@@ -0,0 +1,34 @@
+#ifndef FRACTALEXPLORER_CLC_TONEMAP_HPP
+#define FRACTALEXPLORER_CLC_TONEMAP_HPP
+
+#include <string_view>
+
+static constexpr std::string_view TONE_MAP_SOURCE { R"CL(
+
+// Draws hit counts accumulated by a kernel (see ACCUMULATE in newton_fractal): density is scaled logarithmically
+// to the maximum, which is stored after the last pixel, and gamma corrected, so that rarely hit pixels stay visible.
+// Pixels never hit are white, the most hit ones are black.
+kernel void tone_map(
+    global const uint* density,
+    float gamma,
+    write_only image2d_t image)
+{
+    const int2 coord = { (int)get_global_id(0), (int)get_global_id(1) };
+    const int image_width = get_image_width(image);
+    const int image_height = get_image_height(image);
+    if (coord.x >= image_width || coord.y >= image_height) {
+        return;
+    }
+    const uint max_density = density[image_width * image_height];
+    const uint hits = density[coord.y * image_width + coord.x];
+    float intensity = 0.0f;
+    if (hits != 0) {
+        intensity = pow(log1p((float)hits) / log1p((float)max_density), 1.0f / gamma);
+    }
+    const float value = 1.0f - intensity;
+    write_imagef(image, coord, (float4)(value, value, value, 1.0f));
+}
+
+)CL" };
+
+#endif //FRACTALEXPLORER_CLC_TONEMAP_HPP
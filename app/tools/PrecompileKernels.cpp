@@ -0,0 +1,162 @@
+/**
+ * Build-time kernel precompiler.
+ *
+ * Compiles every kernel from defaultKernels() for a device of the chosen platform and stores resulting binaries in
+ * the ProgramBinaryCache format. Programs are compiled by OpenCLBackend itself, for the whole-device context both
+ * applications use, so that cache keys are those used at runtime; binaries are only picked up if applications
+ * select the same device (see DeviceProbe). With --args, the variant specialized for given arguments (see
+ * KernelBase::specializableArgs) is compiled too, without tuned launch options. Nothing is benchmarked and
+ * nothing is written outside of --output. Exits with non-zero code if any kernel fails to build.
+ *
+ * Usage: clc-precompile --output <dir> [--platform <name substring>] [--args <src>[:<settings>]=<file> ...]
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "DefaultKernels.hpp"
+#include "Utility.hpp"
+
+LOGGER()
+
+static constexpr std::string_view usage =
+    "--output <dir> [--platform <name substring>] [--args <src>[:<settings>]=<file> ...]";
+
+/**
+ * First GPU of the first platform matching given name substring, or its first device if it has no GPUs. Devices
+ * are not probed, that would benchmark the build host.
+ */
+static cl::Device findDevice(const std::string& platformSubstring) {
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+    for (const auto& platform : platforms) {
+        if (platform.getInfo<CL_PLATFORM_NAME>().find(platformSubstring) == std::string::npos) {
+            continue;
+        }
+        std::vector<cl::Device> devices;
+        try {
+            platform.getDevices(CL_DEVICE_TYPE_ALL, &devices);
+        } catch (const cl::Error&) {
+            // platform without devices
+            continue;
+        }
+        auto gpu = std::find_if(devices.begin(), devices.end(), [](const cl::Device& device) {
+            return device.getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_GPU;
+        });
+        if (gpu != devices.end()) {
+            return *gpu;
+        }
+        if (!devices.empty()) {
+            return devices.front();
+        }
+    }
+    auto err = fmt::format("No OpenCL device of platform matching '{}' was found", platformSubstring);
+    logger->error(err);
+    throw std::runtime_error(err);
+}
+
+/**
+ * Parse "<src>[:<settings>]=<file>" into kernel id and default argument values read from file.
+ */
+static std::pair<KernelId, std::string> parseArgsSpec(const std::string& str) {
+    auto equals = str.find('=');
+    if (equals == std::string::npos || equals == 0) {
+        auto err = fmt::format("Invalid --args '{}', expected <src>[:<settings>]=<file>", str);
+        logger->error(err);
+        throw std::invalid_argument(err);
+    }
+    auto idStr = str.substr(0, equals);
+    auto separator = idStr.find(':');
+    KernelId id = separator == std::string::npos
+        ? KernelId { idStr, NEWTON_FRACTAL_ID.settings }
+        : KernelId { idStr.substr(0, separator), idStr.substr(separator + 1) };
+
+    std::filesystem::path path = str.substr(equals + 1);
+    std::ifstream file { path };
+    if (!file) {
+        auto err = fmt::format("Cannot read {}", path.string());
+        logger->error(err);
+        throw std::runtime_error(err);
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return { std::move(id), ss.str() };
+}
+
+/**
+ * Compile registered kernels on current context of backend, the way compileKernel and compileSpecializedKernel
+ * do, and wait for all of them.
+ */
+static void precompile(OpenCLBackend& backend, const std::vector<std::pair<KernelId, std::string>>& argsSpecs) {
+    auto ctx = backend.currentContext();
+    auto programs = backend.precompileRegisteredKernels();
+    for (const auto& [id, conf] : argsSpecs) {
+        auto argTypes = detectArgumentTypesAndNames(backend.compileKernel<NoUserProperties>(id).kernel());
+        auto confStr = conf;
+        absl::StripAsciiWhitespace(&confStr);
+        auto args = defaultArgValues(argTypes, propertiesFromConfig<UIProperties>(argTypes, confStr));
+
+        // launch tuning would time the build host and store results in its cache directory
+        auto options = backend.specializedOptions(id, args, ctx);
+        logger->info(fmt::format("Precompiling kernel ({}, {}) [{}]", id.src, id.settings, options));
+        if (!options.empty()) {
+            programs.push_back(backend.compileProgramAsync(id, ctx, options));
+        }
+    }
+    for (auto& program : programs) {
+        program.get();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::string platformName;
+    std::filesystem::path output;
+    std::vector<std::string> argsSpecStrs;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg { argv[i] };
+        if (arg == "--platform" && i + 1 < argc) {
+            platformName = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "--args" && i + 1 < argc) {
+            argsSpecStrs.emplace_back(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " " << usage << std::endl;
+            return 2;
+        }
+    }
+
+    if (output.empty()) {
+        std::cerr << "--output is required" << std::endl;
+        return 2;
+    }
+
+    try {
+        std::vector<std::pair<KernelId, std::string>> argsSpecs;
+        for (const auto& str : argsSpecStrs) {
+            argsSpecs.push_back(parseArgsSpec(str));
+        }
+
+        auto device = findDevice(platformName);
+        logger->info(fmt::format(
+            "Precompiling kernels for device '{}' into {}", device.getInfo<CL_DEVICE_NAME>(), output.string()
+        ));
+
+        std::filesystem::create_directories(output);
+        OpenCLBackend backend { device };
+        backend.binaryCache().setDirectory(output);
+        registerDefaultKernels(backend);
+        precompile(backend, argsSpecs);
+    } catch (const std::exception& e) {
+        logger->error(fmt::format("Kernel precompilation failed: {}", e.what()));
+        spdlog::shutdown();
+        return 1;
+    }
+
+    // flush asynchronous loggers
+    spdlog::shutdown();
+    return 0;
+}
@@ -0,0 +1,226 @@
+/**
+ * Headless batch renderer.
+ *
+ * Renders a single image of a registered kernel and writes it as PPM or PNG. Arguments are read from a file in
+ * the def/min/max configuration syntax used by the application (only defaults are used), so configurations can
+ * be copied from the UI as is. Needs no display server; OpenCL work is submitted to the batch queue.
+ *
+ * With --evolution, renders an animation instead: arguments follow keyframes from the given file (see Evolution)
+ * and frames are written as Y4M stream (output ending with .y4m) or as image sequence (output containing #####).
+ *
+ * Usage: fractalexplorer-render --args <file> --output <image.png|image.ppm|video.y4m|frame-#####.png>
+ *            [--kernel <src>[:<settings>]] [--size <width>x<height>] [--engine opencl|native|sycl]
+ *            [--evolution <file> [--frames <n>] [--fps <n>]]
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+#include "AnimationRenderer.hpp"
+#include "DefaultKernels.hpp"
+#include "DeviceProbe.hpp"
+#include "ImageIO.hpp"
+#include "NativeNewtonFractal.hpp"
+#include "OpenCLImageEngine.hpp"
+#include "Utility.hpp"
+
+#ifdef FRACTALEXPLORER_WITH_SYCL
+#include "SyclNewtonFractal.hpp"
+#endif
+
+LOGGER()
+
+static constexpr std::string_view usage =
+    "--args <file> --output <image.png|image.ppm|video.y4m|frame-#####.png> "
+    "[--kernel <src>[:<settings>]] [--size <width>x<height>] [--engine opencl|native|sycl] "
+    "[--evolution <file> [--frames <n>] [--fps <n>]]";
+
+static KernelId parseKernelId(const std::string& str) {
+    auto separator = str.find(':');
+    if (separator == std::string::npos) {
+        return { str, NEWTON_FRACTAL_ID.settings };
+    }
+    return { str.substr(0, separator), str.substr(separator + 1) };
+}
+
+static Range<2> parseSize(const std::string& str) {
+    std::istringstream ss { str };
+    size_t width = 0, height = 0;
+    char separator = 0;
+    ss >> width >> separator >> height;
+    if (!ss || separator != 'x' || width == 0 || height == 0) {
+        auto err = fmt::format("Invalid image size '{}', expected <width>x<height>", str);
+        logger->error(err);
+        throw std::invalid_argument(err);
+    }
+    return { width, height };
+}
+
+static size_t parsePositive(const std::string& name, const std::string& str) {
+    size_t pos = 0;
+    unsigned long value = 0;
+    try {
+        value = std::stoul(str, &pos);
+    } catch (const std::logic_error&) {
+        pos = 0;
+    }
+    if (pos != str.size() || value == 0) {
+        auto err = fmt::format("Invalid {} '{}', expected positive integer", name, str);
+        logger->error(err);
+        throw std::invalid_argument(err);
+    }
+    return value;
+}
+
+static std::string readFile(const std::filesystem::path& path) {
+    std::ifstream file { path };
+    if (!file) {
+        auto err = fmt::format("Cannot read {}", path.string());
+        logger->error(err);
+        throw std::runtime_error(err);
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+static ImageEnginePtr makeOpenCLEngine(const char* executable, const KernelId& id, Range<2> size) {
+    auto probeResults = probeDevices(defaultKernels().front().second, cacheDirectory() / "device-probe.txt");
+    const auto& device = fastestDevice(probeResults);
+    logger->info(fmt::format("Using device {}", device.name));
+
+    auto backend = std::make_shared<OpenCLBackend>(device.device);
+    // binaries precompiled during the build (see clc-precompile) are shipped next to the executables
+    backend->binaryCache().addReadOnlyDirectory(
+        std::filesystem::absolute(executable).parent_path() / "kernels");
+    registerDefaultKernels(*backend);
+
+    return std::make_shared<OpenCLImageEngine>(backend, id, size, JobPriority::Batch);
+}
+
+int main(int argc, char *argv[]) {
+    std::filesystem::path argsFile, output, evolutionFile;
+    std::string framesStr, fpsStr = "30";
+    KernelId id = NEWTON_FRACTAL_ID;
+    std::string engineName = "opencl";
+    std::string sizeStr = "512x512";
+
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg { argv[i] };
+        if (arg == "--args" && i + 1 < argc) {
+            argsFile = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "--kernel" && i + 1 < argc) {
+            id = parseKernelId(argv[++i]);
+        } else if (arg == "--size" && i + 1 < argc) {
+            sizeStr = argv[++i];
+        } else if (arg == "--engine" && i + 1 < argc) {
+            engineName = argv[++i];
+        } else if (arg == "--evolution" && i + 1 < argc) {
+            evolutionFile = argv[++i];
+        } else if (arg == "--frames" && i + 1 < argc) {
+            framesStr = argv[++i];
+        } else if (arg == "--fps" && i + 1 < argc) {
+            fpsStr = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " " << usage << std::endl;
+            return 2;
+        }
+    }
+
+    if (argsFile.empty() || output.empty()) {
+        std::cerr << "--args and --output are required" << std::endl;
+        return 2;
+    }
+
+    try {
+        auto size = parseSize(sizeStr);
+        auto start = std::chrono::steady_clock::now();
+
+        if (engineName == "opencl" && !openCLAvailable()) {
+            logger->warn("OpenCL is not available, falling back to native engine");
+            engineName = "native";
+        }
+        ImageEnginePtr engine;
+        if (engineName == "opencl") {
+            engine = makeOpenCLEngine(argv[0], id, size);
+        } else if (engineName == "native" || engineName == "sycl") {
+            if (!(id == NEWTON_FRACTAL_ID)) {
+                auto err = fmt::format("Engine '{}' only supports ({}, {})",
+                    engineName, NEWTON_FRACTAL_ID.src, NEWTON_FRACTAL_ID.settings);
+                logger->error(err);
+                throw std::invalid_argument(err);
+            }
+#ifdef FRACTALEXPLORER_WITH_SYCL
+            if (engineName == "sycl") {
+                engine = std::make_shared<SyclNewtonFractalEngine>(size[0], size[1]);
+            }
+#endif
+            if (engineName == "native") {
+                engine = std::make_shared<NativeNewtonFractalEngine>(size[0], size[1]);
+            }
+        }
+        if (!engine) {
+            auto err = fmt::format("Unknown or disabled engine '{}'", engineName);
+            logger->error(err);
+            throw std::invalid_argument(err);
+        }
+
+        auto conf = readFile(argsFile);
+        absl::StripAsciiWhitespace(&conf);
+        auto argTypes = engine->argTypes();
+        auto args = defaultArgValues(argTypes, propertiesFromConfig<UIProperties>(argTypes, conf));
+
+        if (!evolutionFile.empty()) {
+            auto evolution = Evolution::fromConfig(argTypes, readFile(evolutionFile));
+            auto numFrames = framesStr.empty() ? evolution.lastKeyframe() + 1 : parsePositive("--frames", framesStr);
+            auto sink = makeFrameSink(output.string(), parsePositive("--fps", fpsStr));
+
+            auto computeStart = std::chrono::steady_clock::now();
+            if (auto* openCLEngine = dynamic_cast<OpenCLImageEngine*>(engine.get())) {
+                renderAnimation(openCLEngine->backend(), id, size, args, evolution, numFrames, *sink);
+            } else {
+                renderAnimation(*engine, size, args, evolution, numFrames, *sink);
+            }
+            auto computeMs = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - computeStart).count();
+
+            logger->info(fmt::format(
+                "Rendered {} frames of ({}, {}) {}x{} with {} engine into {}: {:.1f} ms, {:.1f} fps",
+                numFrames, id.src, id.settings, size[0], size[1], engine->name(), output.string(),
+                computeMs, static_cast<double>(numFrames) * 1000.0 / computeMs
+            ));
+            spdlog::shutdown();
+            return 0;
+        }
+
+        auto computeStart = std::chrono::steady_clock::now();
+        engine->compute(args);
+        std::vector<uint32_t> pixels(size[0] * size[1]);
+        engine->read(pixels.data());
+        auto computeEnd = std::chrono::steady_clock::now();
+
+        writeImage(output, pixels.data(), size[0], size[1]);
+
+        auto ms = [](auto duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+        logger->info(fmt::format(
+            "Rendered ({}, {}) {}x{} with {} engine into {}: setup {:.1f} ms, compute {:.1f} ms, total {:.1f} ms",
+            id.src, id.settings, size[0], size[1], engine->name(), output.string(),
+            ms(computeStart - start), ms(computeEnd - computeStart), ms(std::chrono::steady_clock::now() - start)
+        ));
+        if (auto stats = engine->statistics()) {
+            logger->info(fmt::format("Points generated {}, in viewport {}, distinct pixels {}",
+                stats->pointsGenerated, stats->pointsInViewport, stats->distinctPixels));
+        }
+    } catch (const std::exception& e) {
+        logger->error(fmt::format("Rendering failed: {}", e.what()));
+        spdlog::shutdown();
+        return 1;
+    }
+
+    // flush asynchronous loggers
+    spdlog::shutdown();
+    return 0;
+}
@@ -1,17 +1,23 @@
 #include "ComputableImageWidget.hpp"
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
+#include <QOpenGLExtraFunctions>
 #include <QStackedLayout>
 #include <QPainter>
+#include <QKeyEvent>
 #include <QOpenGLVertexArrayObject>
 
+#include <cstring>
+#include <optional>
 #include <utility>
 
 #include "glsl/GLSL_Sources.hpp"
+#include "Metrics.hpp"
+#include "Tracer.hpp"
 
 LOGGER()
 
-#define GLERR     logger->info(fmt::format("LINE {} : {}", __LINE__, gl->glGetError()));
+#define GLERR     LOG_DEBUG("LINE {} : {}", __LINE__, gl->glGetError());
 
 GLuint createVBO(QOpenGLFunctions* gl, size_t size, const float vertexData[]) {
     GLuint vbo;
@@ -22,26 +28,38 @@ GLuint createVBO(QOpenGLFunctions* gl, size_t size, const float vertexData[]) {
 }
 
 ComputableImageWidget2D::ComputableImageWidget2D(
-    OpenCLBackendPtr backend,
-    KernelArgConfigurationStoragePtr<UIProperties> confStorage,
+    ImageEnginePtr engine,
     Dim_2D::RangeType dim,
     KernelId kernelId,
     QWidget *parent)
     : QOpenGLWidget(parent),
-      backend_(backend), confStorage_(std::move(confStorage)),
-      OpenCLComputableImage<Dim_2D>(backend, dim),
+      engine_(std::move(engine)),
       kernelId_(std::move(kernelId)),
       size_(dim) {
     logger->info(
-        fmt::format("Created new ComputableImageWidget2D for displaying KernelId {},{}",
-            kernelId_.src, kernelId_.settings
+        fmt::format("Created new ComputableImageWidget2D for displaying KernelId {},{} with {} engine",
+            kernelId_.src, kernelId_.settings, engine_->name()
             ));
 
     setBaseSize(static_cast<int>(dim[0]), static_cast<int>(dim[1]));
     setMinimumSize(baseSize());
+    // to receive overlay toggle key
+    setFocusPolicy(Qt::StrongFocus);
 
+    // frames arriving faster than they are presented replace each other in frame_
     connect(this, &ComputableImageWidget2D::computed, [this](){
-        repaint();
+        update();
+    });
+
+    // callbacks run on worker thread; queued calls are dropped if widget is destroyed meanwhile
+    worker_ = std::make_unique<RenderWorker>(engine_, dim[0], dim[1], [this](RenderedFramePtr frame) {
+        QMetaObject::invokeMethod(this, [this, frame = std::move(frame)]() {
+            frameComputed(frame);
+        }, Qt::QueuedConnection);
+    }, [this](double fraction) {
+        QMetaObject::invokeMethod(this, [this, fraction]() {
+            emit progress(fraction);
+        }, Qt::QueuedConnection);
     });
 
     QSurfaceFormat format;
@@ -50,6 +68,10 @@ ComputableImageWidget2D::ComputableImageWidget2D(
     setFormat(format);
 }
 
+ComputableImageWidget2D::~ComputableImageWidget2D() {
+    worker_.reset();
+}
+
 void ComputableImageWidget2D::initializeGL() {
     auto* gl = QOpenGLContext::currentContext()->functions();
     logger->info(fmt::format("GL version {}", gl->glGetString(GL_VERSION)));
@@ -73,10 +95,8 @@ void ComputableImageWidget2D::initializeGL() {
 //    gl->glGenVertexArrays( 1, &vao );
 //    gl->glBindVertexArray( vao );
 
-    pixelStorage_.resize(size_[0] * size_[1]);
-
-    static QOpenGLVertexArrayObject vao; vao.create();
-    vao.bind();
+    vao_.create();
+    vao_.bind();
     {
 //        gl->glEnable(GL_TEXTURE_2D);
         gl->glGenTextures(1, &texture);
@@ -92,6 +112,13 @@ void ComputableImageWidget2D::initializeGL() {
             gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
         }
 
+        gl->glGenBuffers(static_cast<GLsizei>(uploadBuffers_.size()), uploadBuffers_.data());
+        for (auto buffer : uploadBuffers_) {
+            gl->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+            gl->glBufferData(GL_PIXEL_UNPACK_BUFFER, size_[0] * size_[1] * sizeof(GLuint), nullptr, GL_STREAM_DRAW);
+        }
+        gl->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
         program.create();
         program.addShaderFromSourceCode(QOpenGLShader::Vertex, getShaderSource("render.vert").data());
         program.addShaderFromSourceCode(QOpenGLShader::Fragment, getShaderSource("render.frag").data());
@@ -123,13 +150,16 @@ void ComputableImageWidget2D::initializeGL() {
 
 void ComputableImageWidget2D::resizeGL(int w, int h) {
     auto* gl = QOpenGLContext::currentContext()->functions();
-    logger->info("ResizeGL called!");
+    LOG_DEBUG("ResizeGL called!");
     gl->glViewport(0, 0, w, h);
 }
 
 void ComputableImageWidget2D::paintGL() {
+    TRACE_SCOPE("ComputableImageWidget2D::paintGL")
+    static auto& paintTime = Metrics::instance().histogram("frame.paint");
+    auto paintStart = std::chrono::steady_clock::now();
     auto* gl = QOpenGLContext::currentContext()->functions();
-    logger->info("PaintGL called!");
+    LOG_TRACE("PaintGL called!");
 
 //    QPainter painter(this);
 //    painter.drawRect(QRect( 43, 42, 29, 299));
@@ -138,18 +168,19 @@ void ComputableImageWidget2D::paintGL() {
 //    img.loadFromData((unsigned char*)pixelStorage_.data(), pixelStorage_.size() * sizeof(unsigned int), "bmp");
 //    painter.drawImage(QPoint(43, 45), img);
 
+    // painter of overlay changes GL state (including bound VAO) behind our back, so GL part is native painting
+    std::optional<QPainter> painter;
+    if (overlayVisible_) {
+        painter.emplace(this);
+        painter->beginNativePainting();
+    }
+
+    vao_.bind();
     gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     gl->glActiveTexture(GL_TEXTURE0);
     gl->glBindTexture(GL_TEXTURE_2D, texture);
-    {
-        gl->glTexSubImage2D(
-            GL_TEXTURE_2D, 0,
-            0, 0, size_[0], size_[1],
-            GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV,
-            pixelStorage_.data()
-        );
-    }
+    auto uploadTime = frame_ ? uploadFrame() : std::chrono::nanoseconds::zero();
 
     program.bind();
     {
@@ -160,33 +191,121 @@ void ComputableImageWidget2D::paintGL() {
         }
     }
     GLERR
+    program.release();
+    vao_.release();
+
+    auto paintEnd = std::chrono::steady_clock::now();
+    overlay_.presented(uploadTime, paintEnd);
+    if (painter) {
+        painter->endNativePainting();
+        overlay_.draw(*painter);
+        painter->end();
+    }
+    paintTime.record(paintEnd - paintStart);
+}
+
+std::chrono::nanoseconds ComputableImageWidget2D::uploadFrame() {
+    TRACE_SCOPE("ComputableImageWidget2D::uploadFrame")
+    auto uploadStart = std::chrono::steady_clock::now();
+    auto* gl = QOpenGLContext::currentContext()->extraFunctions();
+
+    const auto* pixels = frame_->pixels.data();
+    auto rowBytes = size_[0] * sizeof(GLuint);
+    auto bytes = rowBytes * size_[1];
+
+    gl->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffers_[nextUploadBuffer_]);
+    nextUploadBuffer_ = (nextUploadBuffer_ + 1) % uploadBuffers_.size();
+    // invalidating lets driver hand out fresh storage instead of waiting for a transfer still reading the old one
+    auto* staging = static_cast<uint8_t*>(gl->glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(bytes), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
+    ));
+    bool staged = false;
+    if (staging != nullptr) {
+        {
+            TRACE_SCOPE("copy to unpack buffer")
+            std::memcpy(staging, pixels, bytes);
+        }
+        // contents of the buffer are undefined if it was lost while mapped (e.g. display mode change)
+        staged = gl->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+    }
+    if (staged) {
+        // source is offset into the bound unpack buffer; call returns before transfer is done
+        gl->glTexSubImage2D(
+            GL_TEXTURE_2D, 0, 0, 0, size_[0], size_[1], GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, nullptr
+        );
+        gl->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    } else {
+        logger->warn("Failed to stage frame in pixel unpack buffer, uploading it synchronously");
+        gl->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        gl->glTexSubImage2D(
+            GL_TEXTURE_2D, 0, 0, 0, size_[0], size_[1], GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, pixels
+        );
+    }
+
+    // buffer goes back to worker for reuse
+    frame_.reset();
+    return std::chrono::steady_clock::now() - uploadStart;
+}
+
+void ComputableImageWidget2D::keyPressEvent(QKeyEvent* event) {
+    if (event->key() == Qt::Key_H) {
+        setOverlayVisible(!overlayVisible_);
+        return;
+    }
+    QOpenGLWidget::keyPressEvent(event);
+}
+
+void ComputableImageWidget2D::setOverlayVisible(bool visible) {
+    if (overlayVisible_ == visible) {
+        return;
+    }
+    overlayVisible_ = visible;
+    emit overlayVisibleChanged(visible);
+    update();
 }
 
 void ComputableImageWidget2D::compute(KernelArgs args) {
-    logger->info(fmt::format("Computing image [{},{}]", kernelId_.src, kernelId_.settings));
-    // TODO add timing
-    OpenCLComputableImage<Dim_2D>::clear(backend_);
-    OpenCLComputableImage<Dim_2D>::compute<UIProperties>(backend_, kernelId_, args);
-
-    bool hasInterop = false;
-    if (!hasInterop) {
-        // TODO implement interop case
-        cl::size_t<3> origin, region = size_.makeRegion();
-        backend_->currentQueue().enqueueReadImage(image(), CL_TRUE, origin, region, 0, 0, pixelStorage_.data());
-        logger->info(fmt::format("NON ZERO : {}", std::count_if(pixelStorage_.begin(), pixelStorage_.end(), [](auto el) { return el != 0; })));
+    TRACE_SCOPE("ComputableImageWidget2D::compute")
+    overlay_.frameRequested(std::chrono::steady_clock::now());
+    LOG_DEBUG("Requesting image [{},{}]", kernelId_.src, kernelId_.settings);
+    worker_->request(std::move(args));
+}
+
+void ComputableImageWidget2D::frameComputed(RenderedFramePtr frame) {
+    static auto& computeTime = Metrics::instance().histogram("frame.compute");
+    static auto& framesComputed = Metrics::instance().counter("frames.computed");
+    static auto& frozenTrajectories = Metrics::instance().counter("kernel.frozen_trajectories");
+    static auto& solverFailures = Metrics::instance().counter("kernel.solver_failures");
+
+    const auto& stats = frame->statistics;
+    if (stats) {
+        frozenTrajectories.add(stats->frozenTrajectories);
+        solverFailures.add(stats->solverFailures);
+        LOG_DEBUG("Points generated {}, in viewport {}, distinct pixels {}, frozen {}, solver failures {}",
+            stats->pointsGenerated, stats->pointsInViewport, stats->distinctPixels,
+            stats->frozenTrajectories, stats->solverFailures);
     }
 
-    logger->info(fmt::format("Image [{},{}] computed", kernelId_.src, kernelId_.settings));
+    LOG_DEBUG("Image [{},{}] computed, pass {}", kernelId_.src, kernelId_.settings, frame->pass);
+    framesComputed.add();
+    computeTime.record(frame->computeTime + frame->readbackTime);
+    overlay_.computed(
+        frame->computeTime, frame->readbackTime, stats ? static_cast<double>(stats->pointsGenerated) : 0
+    );
+    frame_ = std::move(frame);
     emit computed();
 }
 
-ParameterizedComputableImageWidget::ParameterizedComputableImageWidget(OpenCLBackendPtr backend,
+ParameterizedComputableImageWidget::ParameterizedComputableImageWidget(ImageEnginePtr engine,
     KernelArgConfigurationStoragePtr<UIProperties> confStorage, Range<2> size, KernelId id, QWidget *parent)
 : QWidget(parent),
-  kernel_(backend->compileKernel<UIProperties>(id)),
-  image(new ComputableImageWidget2D(backend, confStorage, size, id)) {
-    args = makeParameterWidgetForKernel(id, kernel_.kernel(), confStorage);
-
+  image(new ComputableImageWidget2D(engine, size, id)),
+  placeholder(new QLabel("Compiling kernel...")),
+  progress(new QProgressBar),
+  engine_(std::move(engine)),
+  confStorage_(std::move(confStorage)),
+  kernelId_(std::move(id)),
+  pendingKernelPoll_(new QTimer(this)) {
     auto* layout = new QVBoxLayout;
 
     auto* settingsLayout = new QHBoxLayout;
@@ -196,21 +315,81 @@ ParameterizedComputableImageWidget::ParameterizedComputableImageWidget(OpenCLBac
     settingsLayout->addWidget(sizeParameters);
     auto* resetParameters = new QPushButton("Reset");
     settingsLayout->addWidget(resetParameters);
+    auto* overlay = new QPushButton("HUD");
+    overlay->setCheckable(true);
+    settingsLayout->addWidget(overlay);
+    auto* trace = new QPushButton("Trace");
+    trace->setCheckable(true);
+    trace->setChecked(Tracer::enabled());
+    settingsLayout->addWidget(trace);
 
     layout->addLayout(settingsLayout);
-    args->setWindowFlags(Qt::WindowStaysOnTopHint);
-    args->setMinimumWidth(250); // TODO depend on slider constratints / be configurable
 
     connect(settings, &QPushButton::clicked, [this](auto checked) {
-        args->setVisible(!args->isVisible());
+        if (args) {
+            args->setVisible(!args->isVisible());
+        }
     });
 
-    connect(args, &KernelArgWidget::valuesChanged, image, &ComputableImageWidget2D::compute);
+    connect(overlay, &QPushButton::toggled, image, &ComputableImageWidget2D::setOverlayVisible);
+    connect(image, &ComputableImageWidget2D::overlayVisibleChanged, overlay, &QPushButton::setChecked);
+
+    connect(trace, &QPushButton::toggled, [](bool checked) {
+        if (checked) {
+            Tracer::instance().start();
+        } else {
+            auto stamp = std::chrono::system_clock::now().time_since_epoch() / std::chrono::seconds(1);
+            Tracer::instance().stop(cacheDirectory() / fmt::format("trace-{}.json", stamp));
+        }
+    });
+
+    // kernel is compiled in background; show placeholder of the same size until it is ready
+    placeholder->setAlignment(Qt::AlignCenter);
+    placeholder->setMinimumSize(static_cast<int>(size[0]), static_cast<int>(size[1]));
+    layout->addWidget(placeholder);
 
+    image->setVisible(false);
     layout->addWidget(image);
 
+    progress->setRange(0, 100);
+    progress->setTextVisible(false);
+    progress->setVisible(false);
+    layout->addWidget(progress);
+    connect(image, &ComputableImageWidget2D::progress, [this](double fraction) {
+        progress->setValue(static_cast<int>(fraction * 100));
+    });
+
+    connect(pendingKernelPoll_, &QTimer::timeout, [this]() {
+        if (engine_->ready()) {
+            pendingKernelPoll_->stop();
+            kernelReady();
+        }
+    });
+    pendingKernelPoll_->start(15);
+
     layout->setMargin(1);
     layout->setSpacing(1);
 
     this->setLayout(layout);
 }
+
+void ParameterizedComputableImageWidget::kernelReady() {
+    ArgsTypesWithNames argTypes;
+    try {
+        argTypes = engine_->argTypes();
+    } catch (const std::exception& e) {
+        logger->error(fmt::format("Failed to compile kernel ({}, {}): {}", kernelId_.src, kernelId_.settings, e.what()));
+        placeholder->setText("Kernel compilation failed, see log for details");
+        return;
+    }
+
+    args = makeParameterWidgetForKernel(kernelId_, argTypes, confStorage_);
+    args->setWindowFlags(Qt::WindowStaysOnTopHint);
+    args->setMinimumWidth(250); // TODO depend on slider constratints / be configurable
+
+    connect(args, &KernelArgWidget::valuesChanged, image, &ComputableImageWidget2D::compute);
+
+    placeholder->setVisible(false);
+    image->setVisible(true);
+    progress->setVisible(true);
+}
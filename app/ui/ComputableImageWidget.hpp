@@ -6,44 +6,105 @@
 #include <QHBoxLayout>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLTexture>
+#include <QOpenGLVertexArrayObject>
+#include <QLabel>
+#include <QProgressBar>
+#include <QTimer>
+
+#include <array>
+#include <chrono>
+#include <future>
 
 #include "ComputableImage.hpp"
+#include "FrameStatisticsOverlay.hpp"
+#include "ImageEngine.hpp"
 #include "KernelArgWidget.hpp"
+#include "RenderWorker.hpp"
 
-class ComputableImageWidget2D : public QOpenGLWidget, private OpenCLComputableImage<Dim_2D> {
+class ComputableImageWidget2D : public QOpenGLWidget {
 
     Q_OBJECT
 
-    OpenCLBackendPtr backend_;
-    KernelArgConfigurationStoragePtr<UIProperties> confStorage_;
+    ImageEnginePtr engine_;
     const KernelId kernelId_;
 
     QOpenGLShaderProgram program;
+    /**
+     * Holds vertex attribute setup; bound on every paint, as QPainter of overlay unbinds it.
+     */
+    QOpenGLVertexArrayObject vao_;
     GLuint vertexBuffer, texture;
     Range<2> size_;
 
-    std::vector<GLuint> pixelStorage_;
+    /**
+     * Computes frames off GUI thread, dropping requests superseded before they are started.
+     */
+    std::unique_ptr<RenderWorker> worker_;
+
+    /**
+     * Latest frame computed by worker and not uploaded yet; a newer one replaces it, so worker never waits for
+     * paints (e.g. while widget is hidden). Worker delivers only frames whose computation completed, so failed or
+     * cancelled ones never reach the texture. Repaints without a new frame (e.g. expose events) only redraw it.
+     */
+    RenderedFramePtr frame_;
+
+    /**
+     * Pixel unpack buffers which frames are uploaded through, alternately: texture is filled from one by DMA while
+     * the next frame is written into the other, so the GL thread does not wait for the transfer.
+     */
+    std::array<GLuint, 2> uploadBuffers_ {};
+    size_t nextUploadBuffer_ = 0;
+
+    /**
+     * Upload frame_ into the texture and release it. Returns time spent on GL thread.
+     */
+    std::chrono::nanoseconds uploadFrame();
+
+    FrameStatisticsOverlay overlay_;
+    bool overlayVisible_ = false;
+
+    /**
+     * Record statistics of frame delivered by worker and schedule its upload.
+     */
+    void frameComputed(RenderedFramePtr);
 
 public:
 
     ComputableImageWidget2D(
-        OpenCLBackendPtr backend,
-        KernelArgConfigurationStoragePtr<UIProperties> confStorage,
+        ImageEnginePtr engine,
         Dim_2D::RangeType dim,
         KernelId kernelId,
         QWidget* parent = nullptr);
 
+    /**
+     * Stops worker before engine and GL resources go away.
+     */
+    ~ComputableImageWidget2D() override;
+
 public slots:
 
     /**
-     * Compute this image in blocking manner.
+     * Request this image to be computed with args. Returns immediately; computed() is emitted once frame is ready,
+     * unless newer args arrive before computation is started.
      */
     void compute(KernelArgs);
 
+    /**
+     * Show or hide frame-time overlay. Can also be toggled with H key.
+     */
+    void setOverlayVisible(bool);
+
 signals:
 
     void computed();
 
+    /**
+     * Fraction of frame being computed which is done so far.
+     */
+    void progress(double);
+
+    void overlayVisibleChanged(bool);
+
 protected:
 
     void initializeGL() override;
@@ -52,6 +113,8 @@ protected:
 
     void paintGL() override;
 
+    void keyPressEvent(QKeyEvent*) override;
+
 };
 
 class ParameterizedComputableImageWidget : public QWidget {
@@ -59,14 +122,25 @@ class ParameterizedComputableImageWidget : public QWidget {
     Q_OBJECT
 
     ComputableImageWidget2D* image;
-    KernelArgWidget* args;
+    KernelArgWidget* args = nullptr;
+    QLabel* placeholder;
+    QProgressBar* progress;
 
-    KernelInstance<UIProperties> kernel_;
+    ImageEnginePtr engine_;
+    KernelArgConfigurationStoragePtr<UIProperties> confStorage_;
+    KernelId kernelId_;
+
+    QTimer* pendingKernelPoll_;
+
+    /**
+     * Called once engine has finished preparing (e.g. compiling kernel) in background.
+     */
+    void kernelReady();
 
 public:
 
     ParameterizedComputableImageWidget(
-        OpenCLBackendPtr backend,
+        ImageEnginePtr engine,
         KernelArgConfigurationStoragePtr<UIProperties> confStorage,
         Range<2> size,
         KernelId id,
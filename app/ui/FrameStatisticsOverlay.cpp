@@ -0,0 +1,63 @@
+#include "FrameStatisticsOverlay.hpp"
+
+#include <fmt/format.h>
+
+static double millis(FrameStatisticsOverlay::Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+FrameStatisticsOverlay::FrameStatisticsOverlay(size_t window)
+    : latency_(window), compute_(window), readback_(window), upload_(window), pointsPerSecond_(window)
+{}
+
+void FrameStatisticsOverlay::frameRequested(Clock::time_point time) {
+    // if several requests are coalesced into one frame, latency is measured from the oldest one
+    if (!requestedAt_) {
+        requestedAt_ = time;
+    }
+}
+
+void FrameStatisticsOverlay::computed(Clock::duration compute, Clock::duration readback, double points) {
+    compute_.add(millis(compute));
+    readback_.add(millis(readback));
+    if (compute.count() > 0) {
+        pointsPerSecond_.add(points / std::chrono::duration<double>(compute).count());
+    }
+}
+
+void FrameStatisticsOverlay::presented(Clock::duration upload, Clock::time_point time) {
+    upload_.add(millis(upload));
+    if (requestedAt_) {
+        latency_.add(millis(time - *requestedAt_));
+        requestedAt_.reset();
+    }
+
+    presentedAt_.push_back(time);
+    while (!presentedAt_.empty() && time - presentedAt_.front() > std::chrono::seconds(1)) {
+        presentedAt_.pop_front();
+    }
+}
+
+void FrameStatisticsOverlay::draw(QPainter& painter) const {
+    auto line = [](const char* name, const RollingStatistics& stats) {
+        auto s = stats.summary();
+        return fmt::format("{:<9} p50 {:6.2f}  p95 {:6.2f}  p99 {:6.2f} ms\n", name, s.p50, s.p95, s.p99);
+    };
+
+    auto text = line("latency", latency_) + line("compute", compute_)
+        + line("readback", readback_) + line("upload", upload_)
+        + fmt::format("{} fps, {:.3g} points/s", presentedAt_.size(), pointsPerSecond_.summary().p50);
+
+    QFont font;
+    font.setFamily("monospace");
+    font.setStyleHint(QFont::TypeWriter);
+    font.setPointSize(9);
+    painter.setFont(font);
+
+    auto flags = Qt::AlignLeft | Qt::AlignTop;
+    auto string = QString::fromStdString(text);
+    auto textArea = QFontMetrics(font).boundingRect(QRect { 8, 8, 0, 0 }, flags, string);
+    painter.fillRect(textArea.adjusted(-4, -4, 4, 4), QColor(0, 0, 0, 160));
+    painter.setPen(QColor(Qt::green));
+    painter.drawText(textArea, flags, string);
+}
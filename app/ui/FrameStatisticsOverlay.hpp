@@ -0,0 +1,50 @@
+#ifndef FRACTALEXPLORER_FRAMESTATISTICSOVERLAY_HPP
+#define FRACTALEXPLORER_FRAMESTATISTICSOVERLAY_HPP
+
+#include <QPainter>
+
+#include <chrono>
+#include <deque>
+#include <optional>
+
+#include "RollingStatistics.hpp"
+
+/**
+ * Frame-time statistics over a sliding window of recent frames, drawn as a text overlay.
+ */
+class FrameStatisticsOverlay {
+
+public:
+
+    using Clock = std::chrono::steady_clock;
+
+    explicit FrameStatisticsOverlay(size_t window = 120);
+
+    /**
+     * Parameters changed and a new frame was requested.
+     */
+    void frameRequested(Clock::time_point);
+
+    void computed(Clock::duration compute, Clock::duration readback, double points);
+
+    /**
+     * Frame was uploaded and drawn.
+     */
+    void presented(Clock::duration upload, Clock::time_point);
+
+    /**
+     * Draw overlay in the top left corner. Only uses QPainter, so GL pipeline is not synchronized.
+     */
+    void draw(QPainter&) const;
+
+private:
+
+    RollingStatistics latency_, compute_, readback_, upload_, pointsPerSecond_;
+
+    std::deque<Clock::time_point> presentedAt_;
+
+    std::optional<Clock::time_point> requestedAt_;
+
+};
+
+#endif //FRACTALEXPLORER_FRAMESTATISTICSOVERLAY_HPP
@@ -122,10 +122,9 @@ KernelArgWidget::KernelArgWidget(
 }
 
 KernelArgWidget* makeParameterWidgetForKernel(
-    KernelId id, cl::Kernel kernel, KernelArgConfigurationStoragePtr<UIProperties> confStorage,
+    KernelId id, const ArgsTypesWithNames& argTypes, KernelArgConfigurationStoragePtr<UIProperties> confStorage,
     QWidget* parent
 ) {
-    auto honey = detectArgumentTypesAndNames(kernel);
-    auto conf = confStorage->findOrParseConfiguration(id, honey);
-    return new KernelArgWidget(honey, conf, parent);
+    auto conf = confStorage->findOrParseConfiguration(id, argTypes);
+    return new KernelArgWidget(argTypes, conf, parent);
 }
\ No newline at end of file
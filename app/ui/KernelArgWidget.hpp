@@ -57,7 +57,7 @@ signals:
 
 };
 
-KernelArgWidget* makeParameterWidgetForKernel(KernelId, cl::Kernel, KernelArgConfigurationStoragePtr<UIProperties>,
-    QWidget* parent = nullptr);
+KernelArgWidget* makeParameterWidgetForKernel(KernelId, const ArgsTypesWithNames&,
+    KernelArgConfigurationStoragePtr<UIProperties>, QWidget* parent = nullptr);
 
 #endif //FRACTALEXPLORER_KERNELARGWIDGET_HPP
@@ -0,0 +1,18 @@
+# write ctest file with a test per name listed by `${TEST_EXECUTABLE} --list`; run as a post-build step
+
+execute_process(
+    COMMAND "${TEST_EXECUTABLE}" --list
+    RESULT_VARIABLE return_code
+    OUTPUT_VARIABLE test_names
+    OUTPUT_STRIP_TRAILING_WHITESPACE
+)
+if (NOT return_code EQUAL 0)
+    message(FATAL_ERROR "Cannot list tests of ${TEST_EXECUTABLE} (exit code ${return_code})")
+endif ()
+
+string(REPLACE "\n" ";" test_names "${test_names}")
+set(content "")
+foreach (test_name ${test_names})
+    string(APPEND content "add_test(${test_name} \"${TEST_EXECUTABLE}\" ${test_name})\n")
+endforeach ()
+file(WRITE "${TESTS_FILE}" "${content}")
@@ -0,0 +1,60 @@
+#include "Testing.hpp"
+
+#include "CoExecution.hpp"
+
+#include <cmath>
+#include <numeric>
+
+static size_t sum(const std::vector<size_t>& rows) {
+    return std::accumulate(rows.begin(), rows.end(), size_t { 0 });
+}
+
+TEST(row_shares_split) {
+    for (size_t devices = 1; devices <= 5; ++devices) {
+        RowShares shares { devices };
+        for (size_t height : { 1, 2, 3, 7, 512, 1080 }) {
+            auto rows = shares.split(height);
+            CHECK(rows.size() == devices);
+            CHECK(sum(rows) == height);
+        }
+    }
+}
+
+TEST(row_shares_rebalance) {
+    RowShares shares { 3 };
+    constexpr size_t height = 1000;
+    // second device is four times as fast as the first one, third one is barely usable
+    const double rowsPerSecond[] = { 1000, 4000, 1 };
+    for (int frame = 0; frame < 20; ++frame) {
+        auto rows = shares.split(height);
+        CHECK(sum(rows) == height);
+        std::vector<double> seconds(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            seconds[i] = rows[i] / rowsPerSecond[i];
+        }
+        shares.rebalance(rows, seconds);
+
+        double total = 0;
+        for (auto share : shares.shares()) {
+            // slow device still gets some rows, so its throughput keeps being measured
+            CHECK(share > 0);
+            total += share;
+        }
+        CHECK(std::abs(total - 1.0) < 1e-9);
+    }
+
+    auto rows = shares.split(height);
+    CHECK(sum(rows) == height);
+    CHECK(rows[2] > 0);
+    CHECK(rows[1] > rows[0]);
+    CHECK(std::abs(static_cast<double>(rows[1]) / rows[0] - 4.0) < 0.2);
+}
+
+TEST(row_shares_without_measurements) {
+    RowShares shares { 2 };
+    // nothing measured: shares stay equal
+    shares.rebalance({ 0, 0 }, { 0.0, 0.0 });
+    auto rows = shares.split(100);
+    CHECK(rows[0] == 50);
+    CHECK(rows[1] == 50);
+}
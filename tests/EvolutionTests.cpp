@@ -0,0 +1,25 @@
+#include "Testing.hpp"
+
+#include "Evolution.hpp"
+#include "NewtonFractalHost.hpp"
+
+TEST(evolution_index_parsing) {
+    const auto& types = newtonFractalSignature();
+
+    // arguments can be referred to by name or by index
+    auto byName = Evolution::fromConfig(types, "0 h 1.0\n10 h 2.0\n");
+    auto byIndex = Evolution::fromConfig(types, "0 7 1.0\n10 7 2.0\n");
+    KernelArgs base;
+    for (auto* evolution : { &byName, &byIndex }) {
+        CHECK(evolution->lastKeyframe() == 10);
+        auto args = evolution->argsAt(5, base);
+        CHECK(std::get<cl_double>(args.at(std::string { "h" }).value) == 1.5);
+    }
+
+    // unknown names, indices past signature, indices out of range of size_t and memory arguments are rejected
+    CHECK_THROWS(Evolution::fromConfig(types, "0 nonexistent 1.0"), PropertyParsingError);
+    CHECK_THROWS(Evolution::fromConfig(types, "0 16 1.0"), PropertyParsingError);
+    CHECK_THROWS(Evolution::fromConfig(types, "0 99999999999999999999999999 1.0"), PropertyParsingError);
+    CHECK_THROWS(Evolution::fromConfig(types, "0 image 1.0"), PropertyParsingError);
+    CHECK_THROWS(Evolution::fromConfig(types, "0 C 1.0"), PropertyParsingError);
+}
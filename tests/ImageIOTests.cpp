@@ -0,0 +1,115 @@
+#include "Testing.hpp"
+
+#include "ImageIO.hpp"
+
+#include <cstring>
+#include <random>
+#include <sstream>
+
+static std::vector<uint32_t> randomPixels(size_t count) {
+    std::mt19937 rng { 42 };
+    std::vector<uint32_t> pixels(count);
+    for (auto& pixel : pixels) {
+        pixel = rng();
+    }
+    return pixels;
+}
+
+static uint32_t bigEndian(const uint8_t* data) {
+    return uint32_t { data[0] } << 24 | uint32_t { data[1] } << 16 | uint32_t { data[2] } << 8 | data[3];
+}
+
+static uint32_t crc32(const uint8_t* data, size_t size) {
+    uint32_t crc = ~0u;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; ++k) {
+            crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+/**
+ * Decode PNG of the form writePNG produces (RGBA8, stored deflate blocks, unfiltered scanlines), verifying every
+ * checksum on the way. Independent of the writer, so that round trip checks the format rather than symmetry.
+ */
+static std::vector<uint32_t> decodePNG(const std::string& file, size_t& width, size_t& height) {
+    static constexpr uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    const auto* bytes = reinterpret_cast<const uint8_t*>(file.data());
+    CHECK(file.size() >= sizeof(signature));
+    CHECK(std::memcmp(bytes, signature, sizeof(signature)) == 0);
+
+    std::vector<uint8_t> data;
+    bool end = false;
+    for (size_t offset = sizeof(signature); !end;) {
+        CHECK(offset + 12 <= file.size());
+        auto length = bigEndian(bytes + offset);
+        CHECK(offset + 12 + length <= file.size());
+        const auto* type = bytes + offset + 4;
+        const auto* payload = type + 4;
+        CHECK(crc32(type, length + 4) == bigEndian(payload + length));
+        if (std::memcmp(type, "IHDR", 4) == 0) {
+            CHECK(length == 13);
+            width = bigEndian(payload);
+            height = bigEndian(payload + 4);
+            // 8 bits per channel, RGBA, deflate, adaptive filtering, no interlace
+            static constexpr uint8_t format[] = { 8, 6, 0, 0, 0 };
+            CHECK(std::memcmp(payload + 8, format, sizeof(format)) == 0);
+        } else if (std::memcmp(type, "IDAT", 4) == 0) {
+            data.insert(data.end(), payload, payload + length);
+        } else {
+            end = std::memcmp(type, "IEND", 4) == 0;
+        }
+        offset += 12 + length;
+    }
+
+    std::vector<uint8_t> raw;
+    CHECK(data.size() >= 6);
+    CHECK((data[0] << 8 | data[1]) % 31 == 0);
+    size_t offset = 2;
+    for (bool last = false; !last;) {
+        CHECK(offset + 5 <= data.size());
+        last = data[offset] & 1;
+        // stored block
+        CHECK((data[offset] >> 1 & 3) == 0);
+        auto len = static_cast<uint16_t>(data[offset + 1] | data[offset + 2] << 8);
+        auto nlen = static_cast<uint16_t>(data[offset + 3] | data[offset + 4] << 8);
+        CHECK(len == static_cast<uint16_t>(~nlen));
+        offset += 5;
+        CHECK(offset + len <= data.size());
+        raw.insert(raw.end(), data.begin() + offset, data.begin() + offset + len);
+        offset += len;
+    }
+    uint32_t a = 1, b = 0;
+    for (auto byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    CHECK(offset + 4 == data.size());
+    CHECK(bigEndian(data.data() + offset) == ((b << 16) | a));
+
+    CHECK(raw.size() == height * (width * 4 + 1));
+    std::vector<uint32_t> pixels(width * height);
+    for (size_t y = 0; y < height; ++y) {
+        const auto* row = raw.data() + y * (width * 4 + 1);
+        CHECK(row[0] == 0);
+        std::memcpy(pixels.data() + y * width, row + 1, width * 4);
+    }
+    return pixels;
+}
+
+TEST(png_round_trip) {
+    // the larger image spans several stored deflate blocks
+    for (auto [width, height] : { std::pair<size_t, size_t> { 7, 3 }, { 301, 97 } }) {
+        auto pixels = randomPixels(width * height);
+        std::stringstream png;
+        writePNG(png, pixels.data(), width, height);
+
+        size_t readWidth = 0, readHeight = 0;
+        auto read = decodePNG(png.str(), readWidth, readHeight);
+        CHECK(readWidth == width);
+        CHECK(readHeight == height);
+        CHECK(read == pixels);
+    }
+}
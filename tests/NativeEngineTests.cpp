@@ -0,0 +1,119 @@
+#include "Testing.hpp"
+
+#include "DeviceProbe.hpp"
+#include "NativeNewtonFractal.hpp"
+
+#include <algorithm>
+#include <complex>
+
+/**
+ * Reference image: newton_fractal computed one work-item at a time on the calling thread.
+ */
+static std::vector<uint32_t> referenceImage(const KernelArgs& args, size_t width, size_t height) {
+    auto params = NewtonFractalParams::fromArgs(args);
+    std::vector<uint32_t> hitMask(RenderStatistics::hitMaskWords(width * height));
+    NewtonFractalCounters counters;
+    for (size_t column = 0; column < width; ++column) {
+        NewtonFractalLanes<1>::compute(params, column, width, height, [&](size_t pixel) {
+            hitMask[pixel >> 5] |= 1u << (pixel & 31);
+        }, counters);
+    }
+    std::vector<uint32_t> pixels(width * height);
+    composeNewtonFractalImage(hitMask.data(), pixels.size(), pixels.data());
+    return pixels;
+}
+
+TEST(native_engine_reference_image) {
+    constexpr size_t width = 96, height = 64;
+    auto args = newtonFractalProbeArgs(256);
+    auto reference = referenceImage(args, width, height);
+
+    NativeNewtonFractalEngine engine { width, height, 4 };
+    engine.compute(args);
+    std::vector<uint32_t> pixels(width * height);
+    engine.read(pixels.data());
+
+    size_t lit = 0, differing = 0;
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        lit += reference[i] == newtonFractalPointPixel;
+        differing += pixels[i] != reference[i];
+    }
+    // reference must not be trivially empty or full
+    CHECK(lit > 0);
+    CHECK(lit < pixels.size());
+    // lanes and threads only change order of plotting; allow for a few points moved by floating point contraction
+    CHECK(differing * 1000 <= pixels.size());
+
+    auto statistics = engine.statistics();
+    CHECK(statistics.has_value());
+    CHECK(statistics->distinctPixels > 0);
+}
+
+TEST(native_engine_random_sequence) {
+    // seed 0x0000000200000001: s.x = 1, s.y = 2. init_state of CLC_Random.hpp gives work-item 0 (id 1)
+    // x = ((1 + 1) & 0xFFFF) * 2 = 4, c = (1 ^ (2 & 0xFFFF0000)) ^ 1 = 0, and work-item 1 (id 2) x = 6, c = 3
+    NewtonFractalLanes<2>::Random rng { 0, 0x0000000200000001ull };
+    Mask<2> both = true;
+    // the first result is x ^ c
+    auto first = rng.next(both);
+    CHECK(first[0] == 4u);
+    CHECK(first[1] == 5u);
+    // 4 * 4294883355 = 3 * 2^32 + 4294631532: x = 4294631532 + 0, c = 3 + (x < 0) = 3
+    // 6 * 4294883355 = 5 * 2^32 + 4294463650: x = 4294463650 + 3, c = 5 + (x < 3) = 5
+    Mask<2> firstOnly = Mask<2>::generate([](size_t i) { return i == 0; });
+    auto second = rng.next(firstOnly);
+    CHECK(second[0] == (4294631532u ^ 3u));
+    CHECK(second[1] == (4294463653u ^ 5u));
+    // generator of inactive lane has not moved
+    auto third = rng.next(both);
+    CHECK(third[1] == (4294463653u ^ 5u));
+}
+
+TEST(native_engine_forward_step) {
+    using Lanes = NewtonFractalLanes<2>;
+    // C = 0.5 - 0.5i, h = 1, so next = a - a/3 - (C / a^2)/3.
+    // a = 1 + i: a^2 = 2i, C / a^2 = -0.25 - 0.25i, next = 2/3 + 1/12 = 0.75 for both parts.
+    // a = 2: C / a^2 = 0.125 - 0.125i, next = 4/3 - 1/24 + i/24 = 31/24 + i/24
+    Lanes::Complex a { Lanes::Real::generate([](size_t i) { return i == 0 ? 1.0 : 2.0; }),
+                       Lanes::Real::generate([](size_t i) { return i == 0 ? 1.0 : 0.0; }) };
+    auto next = Lanes::forwardStep(a, 0.5, -0.5, 1.0);
+    CHECK(std::abs(next.x[0] - 0.75) < 1e-12);
+    CHECK(std::abs(next.y[0] - 0.75) < 1e-12);
+    CHECK(std::abs(next.x[1] - 31.0 / 24.0) < 1e-12);
+    CHECK(std::abs(next.y[1] - 1.0 / 24.0) < 1e-12);
+}
+
+/**
+ * Roots found by solveCubic for every root number, for equation z^3 + a*z^2 + c = 0 with scalar a.
+ */
+static std::vector<std::complex<double>> solveCubic(std::complex<double> a, std::complex<double> c) {
+    using Lanes = NewtonFractalLanes<3>;
+    Lanes::Complex packedA { a.real(), a.imag() };
+    Lanes::Uint rootNumbers = Lanes::Uint::generate([](size_t i) { return static_cast<uint32_t>(i); });
+    Lanes::Complex roots;
+    auto found = Lanes::solveCubic(packedA, c.real(), c.imag(), rootNumbers, roots);
+    CHECK(count(found) == 3);
+    return { { roots.x[0], roots.y[0] }, { roots.x[1], roots.y[1] }, { roots.x[2], roots.y[2] } };
+}
+
+/**
+ * Whether every expected root is found exactly once.
+ */
+static bool sameRoots(std::vector<std::complex<double>> roots, const std::vector<std::complex<double>>& expected) {
+    for (const auto& root : expected) {
+        auto it = std::find_if(roots.begin(), roots.end(), [&](auto r) { return std::abs(r - root) < 1e-9; });
+        if (it == roots.end()) {
+            return false;
+        }
+        roots.erase(it);
+    }
+    return true;
+}
+
+TEST(native_engine_solve_cubic) {
+    // z^3 - 8 = 0: cube roots of 8
+    CHECK(sameRoots(solveCubic(0.0, -8.0), { 2.0, { -1.0, std::sqrt(3.0) }, { -1.0, -std::sqrt(3.0) } }));
+    // roots 1, i and r, with zero z coefficient: i + r(1 + i) = 0, so r = -(1 + i)/2,
+    // a = -(1 + i + r) = -0.5 - 0.5i, c = -(1 * i * r) = -0.5 + 0.5i
+    CHECK(sameRoots(solveCubic({ -0.5, -0.5 }, { -0.5, 0.5 }), { 1.0, { 0.0, 1.0 }, { -0.5, -0.5 } }));
+}
@@ -0,0 +1,30 @@
+#include "Testing.hpp"
+
+#include "SlicedDispatch.hpp"
+
+#include <cmath>
+
+TEST(slice_sizer_convergence) {
+    using namespace std::chrono;
+    constexpr size_t totalRows = 4096, granularity = 8;
+    constexpr double rowsPerSecond = 20000;
+    constexpr nanoseconds latency = milliseconds(16);
+
+    SliceSizer sizer;
+    for (size_t image = 0; image < 4; ++image) {
+        size_t remaining = totalRows;
+        while (remaining > 0) {
+            auto rows = sizer.nextSlice(latency, remaining, totalRows, granularity);
+            CHECK(rows > 0);
+            CHECK(rows <= remaining);
+            CHECK(rows == remaining || rows % granularity == 0);
+            remaining -= rows;
+            sizer.measured(rows, duration_cast<nanoseconds>(duration<double>(rows / rowsPerSecond)));
+        }
+    }
+
+    // device of constant throughput gets slices of target latency, up to granularity
+    auto rows = sizer.nextSlice(latency, totalRows, totalRows, granularity);
+    auto expected = rowsPerSecond * duration<double>(latency).count();
+    CHECK(std::abs(static_cast<double>(rows) - expected) <= granularity);
+}
@@ -0,0 +1,54 @@
+/**
+ * Runs tests given by name on command line, or all of them. Exits with non-zero code if any fails. With --list,
+ * prints names of all tests instead, one per line (see cmake/DiscoverTests.cmake).
+ *
+ * Usage: fractalexplorer-tests [--list | <test name> ...]
+ */
+
+#include "Testing.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <iostream>
+#include <vector>
+
+std::map<std::string, std::function<void()>>& testRegistry() {
+    static std::map<std::string, std::function<void()>> registry;
+    return registry;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> names { argv + 1, argv + argc };
+    if (names.size() == 1 && names.front() == "--list") {
+        for (const auto& [name, test] : testRegistry()) {
+            std::cout << name << '\n';
+        }
+        return 0;
+    }
+    if (names.empty()) {
+        for (const auto& [name, test] : testRegistry()) {
+            names.push_back(name);
+        }
+    }
+
+    int failed = 0;
+    for (const auto& name : names) {
+        auto test = testRegistry().find(name);
+        if (test == testRegistry().end()) {
+            std::cerr << "Unknown test " << name << std::endl;
+            ++failed;
+            continue;
+        }
+        try {
+            test->second();
+            std::cout << "PASSED " << name << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "FAILED " << name << ": " << e.what() << std::endl;
+            ++failed;
+        }
+    }
+
+    // flush asynchronous loggers
+    spdlog::shutdown();
+    return failed == 0 ? 0 : 1;
+}
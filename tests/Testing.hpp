@@ -0,0 +1,54 @@
+#ifndef FRACTALEXPLORER_TESTING_HPP
+#define FRACTALEXPLORER_TESTING_HPP
+
+#include <fmt/format.h>
+
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Minimal test harness. TEST(name) defines a test which TestMain.cpp runs by name (each is a separate ctest test),
+ * CHECK and CHECK_THROWS fail it by throwing TestFailure.
+ */
+class TestFailure : public std::runtime_error {
+public:
+    explicit TestFailure(const std::string& message) : runtime_error(message) {}
+};
+
+std::map<std::string, std::function<void()>>& testRegistry();
+
+struct TestRegistration {
+    TestRegistration(const char* name, std::function<void()> body) {
+        testRegistry().emplace(name, std::move(body));
+    }
+};
+
+#define TEST(name) \
+    static void test_##name(); \
+    static const TestRegistration registration_##name { #name, test_##name }; \
+    static void test_##name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            throw TestFailure(fmt::format("{}:{}: CHECK({}) failed", __FILE__, __LINE__, #condition)); \
+        } \
+    } while (false)
+
+#define CHECK_THROWS(expression, Exception) \
+    do { \
+        bool thrown = false; \
+        try { \
+            expression; \
+        } catch (const Exception&) { \
+            thrown = true; \
+        } \
+        if (!thrown) { \
+            throw TestFailure(fmt::format( \
+                "{}:{}: {} did not throw {}", __FILE__, __LINE__, #expression, #Exception)); \
+        } \
+    } while (false)
+
+#endif //FRACTALEXPLORER_TESTING_HPP